@@ -24,7 +24,7 @@ LOCAL_MODULE    := JNIThreads
 define all-cpp-files-under
 $(patsubst ./%,%, \
   $(shell cd $(LOCAL_PATH) ; \
-          find $(1) -name "include" -prune -o -name "*.cpp" -and -not -name ".*") \
+          find $(1) \( -name "include" -o -name "bench" \) -prune -o -name "*.cpp" -and -not -name ".*" -print) \
  )
 endef
 
@@ -55,12 +55,47 @@ LOCAL_C_INCLUDES += \
 	 
 # for logging
 LOCAL_LDLIBS    += -llog
+# for dladdr() in the mutex contention dump
+LOCAL_LDLIBS    += -ldl
 LOCAL_CFLAGS += -fno-rtti -fno-exceptions -g
+
+# Build Mutex and Condition directly on futexes instead of pthread:
+#   ndk-build THREADMANAGER_FUTEX_MUTEX=true
+ifeq ($(THREADMANAGER_FUTEX_MUTEX),true)
+LOCAL_CFLAGS += -DHAVE_FUTEX_MUTEX
+endif
 # for native asset manager
 LOCAL_LDLIBS    += -landroid
 
 include $(BUILD_SHARED_LIBRARY)
-#include $(BUILD_EXECUTABLE)
+
+#####################################################
+# tmbench: microbenchmarks for the library, run with adb shell.
+#   ndk-build THREADMANAGER_BENCH=true
+#####################################################
+ifeq ($(THREADMANAGER_BENCH),true)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE    := tmbench
+
+LOCAL_SRC_FILES := $(patsubst $(LOCAL_PATH)/%,%,$(wildcard $(LOCAL_PATH)/bench/*.cpp))
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/include \
+	$(LOCAL_PATH)/src \
+	$(LOCAL_PATH)/bench
+
+LOCAL_SHARED_LIBRARIES := JNIThreads
+LOCAL_LDLIBS    += -llog
+LOCAL_CFLAGS += -fno-rtti -fno-exceptions -g -O2
+
+# Mutex is inline; build it the same way as the library.
+ifeq ($(THREADMANAGER_FUTEX_MUTEX),true)
+LOCAL_CFLAGS += -DHAVE_FUTEX_MUTEX
+endif
+
+include $(BUILD_EXECUTABLE)
+endif
 
 
 include $(call all-makefiles-under,$(LOCAL_PATH))
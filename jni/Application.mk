@@ -1,2 +1,6 @@
-#APP_STL := stlport_shared
+#APP_STL := stlport_shared
+# libc++ for <new>, <utility> and <type_traits>; still no exceptions or RTTI.
+APP_STL := c++_static
+# C++20 for coroutines (Coroutine.h).
+APP_CPPFLAGS += -std=c++2a
 APP_PLATFORM := android-21
\ No newline at end of file
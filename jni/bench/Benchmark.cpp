@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Benchmark.h"
+#include "Futex.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace ThreadManager {
+
+enum {
+    MAX_THREADS = 64
+};
+
+static Benchmark* gBenchmarks = NULL;
+static Benchmark** gBenchmarksTail = &gBenchmarks;
+
+Benchmark::Benchmark(const char* name, Function function)
+    : mName(name), mFunction(function), mNext(NULL) {
+    // Static constructors run on one thread, before main().
+    *gBenchmarksTail = this;
+    gBenchmarksTail = &mNext;
+}
+
+int Benchmark::runAll(const char* filter) {
+    int ran = 0;
+    for (Benchmark* b = gBenchmarks; b != NULL; b = b->mNext) {
+        if (filter != NULL && strstr(b->mName, filter) == NULL) {
+            continue;
+        }
+        printf("%s\n", b->mName);
+        fflush(stdout);
+        b->mFunction();
+        ran++;
+    }
+    return ran;
+}
+
+void Benchmark::reportRate(const char* label, uint64_t ops, nsecs_t elapsed) {
+    double ns = ops ? (double) elapsed / ops : 0;
+    double perSecond = elapsed > 0 ? ops * 1e9 / elapsed : 0;
+    printf("  %-36s %10.1f ns/op %14.0f op/s\n", label, ns, perSecond);
+    fflush(stdout);
+}
+
+void Benchmark::reportHistogram(const char* label, const Histogram& histogram) {
+    fflush(stdout);
+    char line[64];
+    snprintf(line, sizeof(line), "  %s", label);
+    histogram.dump(STDOUT_FILENO, line);
+}
+
+struct ThreadRun {
+    Benchmark::ThreadFunction fn;
+    void* arg;
+    volatile int32_t ready;
+    volatile int32_t go;
+    volatile nsecs_t lastEnd;
+};
+
+struct ThreadSlot {
+    ThreadRun* run;
+    int index;
+};
+
+static void* benchmarkThread(void* data) {
+    ThreadSlot* slot = static_cast<ThreadSlot*>(data);
+    ThreadRun* run = slot->run;
+    __atomic_add_fetch(&run->ready, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&run->go, __ATOMIC_ACQUIRE)) {
+        cpuRelax();
+    }
+    run->fn(slot->index, run->arg);
+    nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t last = __atomic_load_n(&run->lastEnd, __ATOMIC_RELAXED);
+    while (end > last && !__atomic_compare_exchange_n(&run->lastEnd, &last, end,
+            false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return NULL;
+}
+
+nsecs_t Benchmark::runThreads(int count, ThreadFunction fn, void* arg) {
+    if (count > MAX_THREADS) {
+        count = MAX_THREADS;
+    }
+    ThreadRun run;
+    run.fn = fn;
+    run.arg = arg;
+    run.ready = 0;
+    run.go = 0;
+    run.lastEnd = 0;
+
+    ThreadSlot slots[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        slots[i].run = &run;
+        slots[i].index = i;
+        if (pthread_create(&threads[i], NULL, benchmarkThread, &slots[i]) != 0) {
+            fprintf(stderr, "tmbench: can't start thread %d of %d\n", i, count);
+            break;
+        }
+        started++;
+    }
+    while (__atomic_load_n(&run.ready, __ATOMIC_ACQUIRE) < started) {
+        sched_yield();
+    }
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    __atomic_store_n(&run.go, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    return run.lastEnd - start;
+}
+
+}; // namespace ThreadManager
+
+using namespace ThreadManager;
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : NULL;
+    if (Benchmark::runAll(filter) == 0) {
+        fprintf(stderr, "tmbench: no benchmark matches '%s'\n", filter ? filter : "");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_BENCH_BENCHMARK_H
+#define _LIBS_BENCH_BENCHMARK_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "Timers.h"
+#include "Histogram.h"
+
+// ---------------------------------------------------------------------------
+namespace ThreadManager {
+// ---------------------------------------------------------------------------
+
+/*
+ * The harness behind tmbench (ndk-build THREADMANAGER_BENCH=true).
+ *
+ * A BENCHMARK(name) body runs once, times its own loop and prints what it
+ * measured with reportRate() or reportHistogram().  "tmbench [filter]"
+ * runs every benchmark whose name contains filter.
+ */
+class Benchmark {
+public:
+    typedef void (*Function)();
+    typedef void (*ThreadFunction)(int index, void* arg);
+
+    Benchmark(const char* name, Function function);
+
+    // Runs the matching benchmarks; returns how many ran.
+    static int runAll(const char* filter);
+
+    // One line: label, ns per op and ops per second.
+    static void reportRate(const char* label, uint64_t ops, nsecs_t elapsed);
+
+    // One line of per-op latency percentiles.
+    static void reportHistogram(const char* label, const Histogram& histogram);
+
+    // Runs fn(index, arg) on count threads released together, and returns
+    // the time from the release until the last one finished.
+    static nsecs_t runThreads(int count, ThreadFunction fn, void* arg);
+
+private:
+    const char* mName;
+    Function    mFunction;
+    Benchmark*  mNext;
+};
+
+// Keeps the compiler from dropping a computation whose result is unused.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    __asm__ __volatile__("" : : "r"(&value) : "memory");
+}
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static ::ThreadManager::Benchmark sBenchmark_##name(#name, name); \
+    static void name()
+
+// ---------------------------------------------------------------------------
+}; // namespace ThreadManager
+// ---------------------------------------------------------------------------
+
+#endif // _LIBS_BENCH_BENCHMARK_H
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Cost of one systemTime() call for each clock id.  The numbers quoted
+ * when the coarse and fast clocks were added came from this loop.
+ */
+
+#include "Benchmark.h"
+
+using namespace ThreadManager;
+
+enum {
+    CLOCK_READS = 5000000
+};
+
+BENCHMARK(systemTimeCost) {
+    static const struct {
+        const char* name;
+        int clock;
+    } CLOCKS[] = {
+        { "SYSTEM_TIME_REALTIME",         SYSTEM_TIME_REALTIME },
+        { "SYSTEM_TIME_MONOTONIC",        SYSTEM_TIME_MONOTONIC },
+        { "SYSTEM_TIME_BOOTTIME",         SYSTEM_TIME_BOOTTIME },
+        { "SYSTEM_TIME_MONOTONIC_COARSE", SYSTEM_TIME_MONOTONIC_COARSE },
+        { "SYSTEM_TIME_FAST",             SYSTEM_TIME_FAST },
+        { "SYSTEM_TIME_THREAD",           SYSTEM_TIME_THREAD },
+    };
+    // The fast clock calibrates on first use; keep that out of the loop.
+    systemTime(SYSTEM_TIME_FAST);
+
+    for (size_t c = 0; c < sizeof(CLOCKS) / sizeof(CLOCKS[0]); c++) {
+        nsecs_t last = 0;
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int i = 0; i < CLOCK_READS; i++) {
+            last = systemTime(CLOCKS[c].clock);
+            doNotOptimize(last);
+        }
+        nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+        Benchmark::reportRate(CLOCKS[c].name, CLOCK_READS, elapsed);
+    }
+}
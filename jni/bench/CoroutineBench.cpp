@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Coroutine costs: starting a Task whose frame comes from the warm
+ * CoroutineFramePool, and hopping between two loopers with resumeOn().
+ */
+
+#include "Benchmark.h"
+#include "Coroutine.h"
+#include "Futex.h"
+#include "Looper.h"
+#include "Thread.h"
+
+using namespace ThreadManager;
+
+enum {
+    TASK_STARTS = 1000000,
+    HOPS        = 20000     // round trips, two hops each
+};
+
+class IdlePolicy : public LooperPolicyInterface {
+public:
+    virtual void attachJavaThread() { }
+    virtual void detachJavaThread() { }
+};
+
+static Task countOne(int* counter) {
+    (*counter)++;
+    co_return;
+}
+
+BENCHMARK(coroutineStart) {
+    int counter = 0;
+    // Warm the pool so the loop reuses one frame.
+    countOne(&counter);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < TASK_STARTS; i++) {
+        countOne(&counter);
+    }
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    doNotOptimize(counter);
+    Benchmark::reportRate("start and finish a Task", TASK_STARTS, elapsed);
+}
+
+static Task bounce(LooperInterface* a, LooperInterface* b, nsecs_t* elapsed,
+        volatile int32_t* done) {
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < HOPS; i++) {
+        co_await resumeOn(a);
+        co_await resumeOn(b);
+    }
+    *elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    __atomic_store_n(done, 1, __ATOMIC_RELEASE);
+    futexWake(done, 1);
+}
+
+BENCHMARK(coroutineHop) {
+    // The looper threads run until tmbench exits.
+    static IdlePolicy policy;
+    HandleThread* threadA = new HandleThread(&policy);
+    HandleThread* threadB = new HandleThread(&policy);
+    threadA->run("tm:bench-a", PRIORITY_DEFAULT);
+    threadB->run("tm:bench-b", PRIORITY_DEFAULT);
+
+    nsecs_t elapsed = 0;
+    volatile int32_t done = 0;
+    bounce(threadA->getLooper(), threadB->getLooper(), &elapsed, &done);
+    while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+        futexWait(&done, 0, NULL);
+    }
+    Benchmark::reportRate("resumeOn() hop", 2 * HOPS, elapsed);
+}
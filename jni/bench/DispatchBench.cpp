@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Cost of one dispatchMessage() call through TypedHandler's table and
+ * through the MessageHandler -> MessageConsumer -> policy path.  The
+ * numbers quoted when TypedHandler was added came from this loop.
+ */
+
+#include "Benchmark.h"
+#include "Looper.h"
+#include "Message.h"
+#include "Messagehandler.h"
+#include "MessageQueue.h"
+#include "Thread.h"
+#include "TypedHandler.h"
+
+using namespace ThreadManager;
+
+enum {
+    DISPATCHES = 10000000
+};
+
+struct Add { enum { what = 1 }; };
+struct Reset { enum { what = 2 }; };
+
+class SumHandler : public TypedHandler<SumHandler, Add, Reset> {
+public:
+    explicit SumHandler(LooperInterface* looper)
+        : TypedHandler<SumHandler, Add, Reset>(looper, looper->getQueue()), mSum(0) { }
+
+    void handle(Add, const Message& msg) { mSum += msg.getArg1(); }
+    void handle(Reset, const Message& /*msg*/) { mSum = 0; }
+
+    int64_t mSum;
+};
+
+class SumPolicy : public LooperPolicyInterface, public MessageHandlerPolicyInterface {
+public:
+    SumPolicy() : mSum(0) { }
+    virtual void attachJavaThread() { }
+    virtual void detachJavaThread() { }
+    virtual void notifyMessage(const Message* msg) { mSum += msg->getArg1(); }
+
+    int64_t mSum;
+};
+
+// Calls through the base interface, as the looper does.
+static nsecs_t timeDispatch(MessageHandlerInterface* handler, Message* msg) {
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < DISPATCHES; i++) {
+        handler->dispatchMessage(msg);
+    }
+    return systemTime(SYSTEM_TIME_MONOTONIC) - start;
+}
+
+BENCHMARK(dispatch) {
+    // The looper thread runs until tmbench exits; messages are dispatched
+    // on this thread and never queued.
+    static SumPolicy policy;
+    HandleThread* thread = new HandleThread(&policy);
+    thread->run("tm:bench-dispatch", PRIORITY_DEFAULT);
+    LooperInterface* looper = thread->getLooper();
+
+    SumHandler typed(looper);
+    Message* msg = Message::createMessage(&typed, Add::what, 1, 0);
+    Benchmark::reportRate("TypedHandler", DISPATCHES, timeDispatch(&typed, msg));
+    msg->recycle();
+    doNotOptimize(typed.mSum);
+
+    MessageHandler legacy(looper, looper->getQueue(), &policy);
+    msg = Message::createMessage(&legacy, Add::what, 1, 0);
+    Benchmark::reportRate("MessageHandler", DISPATCHES, timeDispatch(&legacy, msg));
+    msg->recycle();
+    doNotOptimize(policy.mSum);
+}
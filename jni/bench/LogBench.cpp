@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * What an ALOGx call costs the calling thread at each level, written
+ * synchronously and through the async ring.  Levels below LOG_MIN_LEVEL
+ * are compiled out and should cost nothing.  The records go to logcat
+ * under THREAD_MANAGER.
+ */
+
+#include "Benchmark.h"
+#include "logging.h"
+
+#include <stdio.h>
+
+using namespace ThreadManager;
+
+enum {
+    LOG_RECORDS = 20000
+};
+
+#define TIME_LOG_LEVEL(macro, mode) \
+    do { \
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC); \
+        for (int i = 0; i < LOG_RECORDS; i++) { \
+            macro("tmbench %s record %d of %d", mode, i, LOG_RECORDS); \
+        } \
+        nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start; \
+        char label[64]; \
+        snprintf(label, sizeof(label), "%s %s", #macro, mode); \
+        Benchmark::reportRate(label, LOG_RECORDS, elapsed); \
+    } while (0)
+
+static void timeLevels(const char* mode) {
+    TIME_LOG_LEVEL(ALOGV, mode);
+    TIME_LOG_LEVEL(ALOGD, mode);
+    TIME_LOG_LEVEL(ALOGI, mode);
+    TIME_LOG_LEVEL(ALOGW, mode);
+}
+
+BENCHMARK(logThroughput) {
+    printf("  LOG_MIN_LEVEL %d\n", LOG_MIN_LEVEL);
+    timeLevels("sync");
+
+    androidSetAsyncLogging(1);
+    timeLevels("async");
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    androidFlushAsyncLog();
+    Benchmark::reportRate("async flush", 1, systemTime(SYSTEM_TIME_MONOTONIC) - start);
+    androidSetAsyncLogging(0);
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Mutex and Condition costs, to compare the pthread build with the futex
+ * one (ndk-build THREADMANAGER_FUTEX_MUTEX=true THREADMANAGER_BENCH=true).
+ */
+
+#include "Benchmark.h"
+#include "Condition.h"
+#include "Mutex.h"
+
+#include <stdio.h>
+
+using namespace ThreadManager;
+
+#ifdef HAVE_FUTEX_MUTEX
+static const char* const MUTEX_KIND = "futex";
+#else
+static const char* const MUTEX_KIND = "pthread";
+#endif
+
+enum {
+    LOCK_OPS     = 4000000,     // split between the threads
+    HANDOFF_OPS  = 100000
+};
+
+BENCHMARK(mutexUncontended) {
+    Mutex lock;
+    uint64_t counter = 0;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < LOCK_OPS; i++) {
+        Mutex::Autolock _l(lock);
+        counter++;
+    }
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    doNotOptimize(counter);
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s lock+unlock", MUTEX_KIND);
+    Benchmark::reportRate(label, LOCK_OPS, elapsed);
+}
+
+struct SharedCounter {
+    Mutex lock;
+    uint64_t value;
+    int opsPerThread;
+};
+
+static void incrementShared(int /*index*/, void* arg) {
+    SharedCounter* shared = static_cast<SharedCounter*>(arg);
+    for (int i = 0; i < shared->opsPerThread; i++) {
+        Mutex::Autolock _l(shared->lock);
+        shared->value++;
+    }
+}
+
+// Every thread increments one counter under one Mutex: the lock is always
+// contended, so this times the spin-then-sleep path and the wakeups.
+BENCHMARK(mutexContended) {
+    static const int THREADS[] = { 2, 4, 8 };
+    for (size_t t = 0; t < sizeof(THREADS) / sizeof(THREADS[0]); t++) {
+        SharedCounter shared;
+        shared.value = 0;
+        shared.opsPerThread = LOCK_OPS / THREADS[t];
+        nsecs_t elapsed = Benchmark::runThreads(THREADS[t], incrementShared, &shared);
+
+        char label[64];
+        snprintf(label, sizeof(label), "%s %d threads", MUTEX_KIND, THREADS[t]);
+        Benchmark::reportRate(label, shared.value, elapsed);
+    }
+}
+
+struct Handoff {
+    Mutex lock;
+    Condition turnChanged;
+    int turn;
+};
+
+static void passTurn(int index, void* arg) {
+    Handoff* handoff = static_cast<Handoff*>(arg);
+    Mutex::Autolock _l(handoff->lock);
+    for (int i = 0; i < HANDOFF_OPS; i++) {
+        while (handoff->turn != index) {
+            handoff->turnChanged.wait(handoff->lock);
+        }
+        handoff->turn = !index;
+        handoff->turnChanged.signal();
+    }
+}
+
+// Two threads take turns through a Condition: one wait and one signal per
+// handoff, each waking a sleeping thread.
+BENCHMARK(conditionHandoff) {
+    Handoff handoff;
+    handoff.turn = 0;
+    nsecs_t elapsed = Benchmark::runThreads(2, passTurn, &handoff);
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s condition handoff", MUTEX_KIND);
+    Benchmark::reportRate(label, 2 * HANDOFF_OPS, elapsed);
+}
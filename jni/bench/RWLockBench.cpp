@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Read-heavy access to a small shared value from 1 to 16 threads: one
+ * write per WRITE_EVERY operations, the rest reads, through a Mutex, an
+ * RWLock and a SeqLock.
+ */
+
+#include "Benchmark.h"
+#include "Mutex.h"
+#include "RWLock.h"
+#include "SeqLock.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace ThreadManager;
+
+enum {
+    OPS_PER_THREAD  = 500000,
+    WRITE_EVERY     = 1000
+};
+
+struct Config {
+    int64_t version;
+    int64_t values[3];
+};
+
+struct GuardedConfig {
+    Mutex mutex;
+    RWLock rwlock;
+    SeqLock<Config> seqlock;
+    Config config;
+};
+
+static inline int64_t sum(const Config& config) {
+    return config.version + config.values[0] + config.values[1] + config.values[2];
+}
+
+static void useMutex(int /*index*/, void* arg) {
+    GuardedConfig* guarded = static_cast<GuardedConfig*>(arg);
+    int64_t total = 0;
+    for (int i = 1; i <= OPS_PER_THREAD; i++) {
+        Mutex::Autolock _l(guarded->mutex);
+        if (i % WRITE_EVERY == 0) {
+            guarded->config.version++;
+        } else {
+            total += sum(guarded->config);
+        }
+    }
+    doNotOptimize(total);
+}
+
+static void useRWLock(int /*index*/, void* arg) {
+    GuardedConfig* guarded = static_cast<GuardedConfig*>(arg);
+    int64_t total = 0;
+    for (int i = 1; i <= OPS_PER_THREAD; i++) {
+        if (i % WRITE_EVERY == 0) {
+            RWLock::AutoWLock _l(guarded->rwlock);
+            guarded->config.version++;
+        } else {
+            RWLock::AutoRLock _l(guarded->rwlock);
+            total += sum(guarded->config);
+        }
+    }
+    doNotOptimize(total);
+}
+
+static void useSeqLock(int /*index*/, void* arg) {
+    GuardedConfig* guarded = static_cast<GuardedConfig*>(arg);
+    int64_t total = 0;
+    for (int i = 1; i <= OPS_PER_THREAD; i++) {
+        if (i % WRITE_EVERY == 0) {
+            SeqLock<Config>::AutoWrite _w(guarded->seqlock);
+            _w.value().version++;
+        } else {
+            total += sum(guarded->seqlock.read());
+        }
+    }
+    doNotOptimize(total);
+}
+
+BENCHMARK(readHeavy) {
+    static const int THREADS[] = { 1, 2, 4, 8, 16 };
+    static const struct {
+        const char* name;
+        Benchmark::ThreadFunction fn;
+    } LOCKS[] = {
+        { "Mutex",   useMutex },
+        { "RWLock",  useRWLock },
+        { "SeqLock", useSeqLock },
+    };
+    for (size_t l = 0; l < sizeof(LOCKS) / sizeof(LOCKS[0]); l++) {
+        for (size_t t = 0; t < sizeof(THREADS) / sizeof(THREADS[0]); t++) {
+            GuardedConfig guarded;
+            memset(&guarded.config, 0, sizeof(guarded.config));
+            nsecs_t elapsed = Benchmark::runThreads(THREADS[t], LOCKS[l].fn, &guarded);
+
+            char label[64];
+            snprintf(label, sizeof(label), "%s %d threads", LOCKS[l].name, THREADS[t]);
+            Benchmark::reportRate(label, (uint64_t) THREADS[t] * OPS_PER_THREAD, elapsed);
+        }
+    }
+}
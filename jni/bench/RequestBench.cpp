@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Ping-pong through sendMessageAndWait(): this thread sends a request to
+ * a HandleThread, which replies with arg1 + 1.  Each sample is one round
+ * trip: enqueue, wake the looper, dispatch, reply and wake the sender.
+ */
+
+#include "Benchmark.h"
+#include "Looper.h"
+#include "Messagehandler.h"
+#include "MessageQueue.h"
+#include "Thread.h"
+
+#include <stdio.h>
+
+using namespace ThreadManager;
+
+enum {
+    ROUND_TRIPS = 20000
+};
+
+class EchoPolicy : public LooperPolicyInterface, public MessageHandlerPolicyInterface {
+public:
+    virtual void attachJavaThread() { }
+    virtual void detachJavaThread() { }
+    virtual void notifyMessage(const Message* msg) {
+        msg->reply(msg->getArg1() + 1);
+    }
+};
+
+BENCHMARK(requestPingPong) {
+    // The looper thread runs until tmbench exits.
+    static EchoPolicy policy;
+    HandleThread* thread = new HandleThread(&policy);
+    thread->run("tm:bench-echo", PRIORITY_DEFAULT);
+    LooperInterface* looper = thread->getLooper();
+    MessageHandler handler(looper, looper->getQueue(), &policy);
+
+    Histogram latency;
+    int failures = 0;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        Message* msg = handler.obtainMessage(0, i, 0);
+        int32_t result = -1;
+        nsecs_t sent = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (handler.sendMessageAndWait(*msg, -1, &result) != NO_ERROR || result != i + 1) {
+            failures++;
+        }
+        latency.record(systemTime(SYSTEM_TIME_MONOTONIC) - sent);
+    }
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    Benchmark::reportRate("round trips", ROUND_TRIPS, elapsed);
+    Benchmark::reportHistogram("round trip", latency);
+    if (failures) {
+        printf("  %d round trips failed\n", failures);
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Run-to-first-instruction: how long androidCreateRawThreadEtc() takes to
+ * get a new thread into its entry function, with and without the parked
+ * thread cache.
+ */
+
+#include "Benchmark.h"
+#include "AndroidThreads.h"
+#include "Futex.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace ThreadManager;
+
+enum {
+    THREAD_STARTS = 2000
+};
+
+struct StartProbe {
+    volatile nsecs_t createdAt;
+    volatile int32_t started;
+    Histogram latency;
+};
+
+static int probeEntry(void* data) {
+    StartProbe* probe = static_cast<StartProbe*>(data);
+    probe->latency.record(systemTime(SYSTEM_TIME_MONOTONIC) - probe->createdAt);
+    __atomic_store_n(&probe->started, 1, __ATOMIC_RELEASE);
+    futexWake(&probe->started, 1);
+    return 0;
+}
+
+static void measureStarts(const char* label) {
+    StartProbe probe;
+    for (int i = 0; i < THREAD_STARTS; i++) {
+        probe.started = 0;
+        probe.createdAt = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (!androidCreateRawThreadEtc(probeEntry, &probe, "tm:bench",
+                ANDROID_PRIORITY_NORMAL, 0, NULL)) {
+            fprintf(stderr, "tmbench: can't create a thread\n");
+            return;
+        }
+        while (!__atomic_load_n(&probe.started, __ATOMIC_ACQUIRE)) {
+            futexWait(&probe.started, 0, NULL);
+        }
+        // Let the thread return and park (or exit) before the next start.
+        usleep(200);
+    }
+    Benchmark::reportHistogram(label, probe.latency);
+}
+
+BENCHMARK(threadStart) {
+    androidSetThreadCacheLimits(0, 0);
+    measureStarts("new thread");
+
+    androidSetThreadCacheLimits(4, s2ns(1));
+    measureStarts("parked thread");
+    androidSetThreadCacheLimits(0, 0);
+}
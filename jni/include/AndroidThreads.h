@@ -53,6 +53,17 @@ extern int androidCreateRawThreadEtc(android_thread_func_t entryFunction,
                                      size_t threadStackSize,
                                      android_thread_id_t *threadId);
 
+// Same as androidCreateRawThreadEtc, but the new thread is placed in the
+// scheduling class described by "sched" before entryFunction runs.  A
+// real-time or deadline request that the kernel refuses falls back to
+// sched->nice; see androidSetThreadPriorityEtc().
+extern int androidCreateRawThreadSchedEtc(android_thread_func_t entryFunction,
+                                          void *userData,
+                                          const char* threadName,
+                                          const android_thread_sched_t* sched,
+                                          size_t threadStackSize,
+                                          android_thread_id_t *threadId);
+
 // Used by the Java Runtime to control how threads are created, so that
 // they can be proper and lovely Java threads.
 typedef int (*android_create_thread_fn)(android_thread_func_t entryFunction,
@@ -64,6 +75,19 @@ typedef int (*android_create_thread_fn)(android_thread_func_t entryFunction,
 
 extern void androidSetCreateThreadFunc(android_create_thread_fn func);
 
+// Keep up to maxIdleThreads threads created by androidCreateRawThreadEtc()
+// parked for idleTimeoutNs after their entry function returns, and reuse them
+// for later requests with the same stack size.  Zero (the default) disables
+// the cache.  A reused thread keeps its thread-specific data; anything that
+// must not leak from one entry function to the next should be reset by a
+// recycle hook.
+extern void androidSetThreadCacheLimits(size_t maxIdleThreads, int64_t idleTimeoutNs);
+
+// Called on a cached thread after its entry function returned and before it
+// is parked.  Returns 0 on success, or -1 if too many hooks are registered.
+typedef void (*android_thread_recycle_fn)(void);
+extern int androidAddThreadRecycleHook(android_thread_recycle_fn hook);
+
 // ------------------------------------------------------------------
 // Extra functions working with raw pids.
 
@@ -80,6 +104,19 @@ extern int androidSetThreadPriority(int32_t tid, int prio);
 // Get the current priority of a particular thread. Returns one of the
 // ANDROID_PRIORITY constants or a negative result in case of error.
 extern int androidGetThreadPriority(int32_t tid);
+
+// Change the scheduling class of a particular thread.  ANDROID_SCHED_DEADLINE
+// degrades to ANDROID_SCHED_FIFO (when sched->priority > 0) and then to the
+// nice level; ANDROID_SCHED_FIFO and ANDROID_SCHED_RR degrade to the nice
+// level.  Returns NO_ERROR if the requested class was applied, WOULD_BLOCK if
+// a fallback was applied instead (errno holds the reason), or
+// INVALID_OPERATION if nothing could be applied.  Thread ID zero means
+// current thread.
+extern int androidSetThreadPriorityEtc(int32_t tid, const android_thread_sched_t* sched);
+
+// Get the effective scheduling class of a particular thread, as reported by
+// the kernel.  Returns 0 on success, or INVALID_OPERATION with errno set.
+extern int androidGetThreadPriorityEtc(int32_t tid, android_thread_sched_t* sched);
 #endif
 
 #ifdef __cplusplus
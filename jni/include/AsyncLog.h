@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Asynchronous logging.  While enabled, ALOGx calls format into a ring
+ *  owned by the calling thread and return; a background thread hands the
+ *  records to logd.  Errors are still written synchronously, after
+ *  whatever is queued, so they are not lost if the process dies.
+ */
+
+#ifndef _LIBS_UTILS_ASYNC_LOG_H
+#define _LIBS_UTILS_ASYNC_LOG_H
+
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Where ALOGx ends up: the calling thread's ring while async logging is on,
+// __android_log_vprint otherwise.  tag must outlive the process (LOG_TAG).
+int androidLogPrint(int prio, const char* tag, const char* fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+int androidLogVPrint(int prio, const char* tag, const char* fmt, va_list ap);
+
+// Start or stop the drain thread.  Stopping drains what is queued.
+void androidSetAsyncLogging(int enable);
+
+// Write out everything queued so far before returning.
+void androidFlushAsyncLog(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _LIBS_UTILS_ASYNC_LOG_H
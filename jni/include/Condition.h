@@ -24,6 +24,7 @@
 #include <sys/types.h>
 #include <time.h>
 #include <stdlib.h>
+#include <limits.h>
 
 
 #if defined(HAVE_PTHREADS)
@@ -37,6 +38,9 @@ namespace ThreadManager {
 /*
  * Condition variable class.  The implementation is system-dependent.
  *
+ * Timeouts are measured against CLOCK_MONOTONIC, so wall-clock changes
+ * neither cut a wait short nor stretch it.
+ *
  * Condition variables are paired up with mutexes.  Lock the mutex,
  * call wait(), then either re-wait() if things aren't quite what you want,
  * or unlock the mutex and continue.  All threads calling wait() must
@@ -56,13 +60,20 @@ public:
     status_t wait(Mutex& mutex);
     // same with relative timeout
     status_t waitRelative(Mutex& mutex, nsecs_t reltime);
+    // same with an absolute SYSTEM_TIME_MONOTONIC deadline; use this in
+    // predicate loops so the timeout is not recomputed after each wakeup
+    status_t waitUntil(Mutex& mutex, nsecs_t monotonicDeadline);
     // Signal the condition variable, allowing one thread to continue.
     void signal();
     // Signal the condition variable, allowing all threads to continue.
     void broadcast();
 
 private:
-#if defined(HAVE_PTHREADS)
+#if defined(HAVE_FUTEX_MUTEX)
+    // bumped by every signal()/broadcast(); waiters sleep until it changes
+    volatile int32_t mSeq;
+    bool    mShared;
+#elif defined(HAVE_PTHREADS)
     pthread_cond_t mCond;
 #else
     void*   mState;
@@ -71,21 +82,75 @@ private:
 
 // ---------------------------------------------------------------------------
 
-#if defined(HAVE_PTHREADS)
+#if defined(HAVE_FUTEX_MUTEX)
+
+inline Condition::Condition() : mSeq(0), mShared(false) {
+}
+inline Condition::Condition(int type) : mSeq(0), mShared(type == SHARED) {
+}
+inline Condition::~Condition() {
+}
+inline status_t Condition::wait(Mutex& mutex) {
+    int32_t seq = __atomic_load_n(&mSeq, __ATOMIC_RELAXED);
+    mutex.unlock();
+    int res = futexWait(&mSeq, seq, NULL, mShared);
+    mutex.lock();
+    // A changed sequence (-EAGAIN) or a signal (-EINTR) are plain wakeups.
+    return res == -ETIMEDOUT ? TIMED_OUT : NO_ERROR;
+}
+inline status_t Condition::waitRelative(Mutex& mutex, nsecs_t reltime) {
+    struct timespec ts;
+    if (reltime < 0) {
+        reltime = 0;
+    }
+    ts.tv_sec  = reltime/1000000000;
+    ts.tv_nsec = reltime%1000000000;
+    int32_t seq = __atomic_load_n(&mSeq, __ATOMIC_RELAXED);
+    mutex.unlock();
+    int res = futexWait(&mSeq, seq, &ts, mShared);
+    mutex.lock();
+    return res == -ETIMEDOUT ? TIMED_OUT : NO_ERROR;
+}
+inline status_t Condition::waitUntil(Mutex& mutex, nsecs_t monotonicDeadline) {
+    struct timespec ts;
+    if (monotonicDeadline < 0) {
+        monotonicDeadline = 0;
+    }
+    ts.tv_sec  = monotonicDeadline/1000000000;
+    ts.tv_nsec = monotonicDeadline%1000000000;
+    int32_t seq = __atomic_load_n(&mSeq, __ATOMIC_RELAXED);
+    mutex.unlock();
+    int res = futexWaitUntil(&mSeq, seq, &ts, mShared);
+    mutex.lock();
+    return res == -ETIMEDOUT ? TIMED_OUT : NO_ERROR;
+}
+inline void Condition::signal() {
+    __atomic_fetch_add(&mSeq, 1, __ATOMIC_RELEASE);
+    futexWake(&mSeq, 1, mShared);
+}
+inline void Condition::broadcast() {
+    __atomic_fetch_add(&mSeq, 1, __ATOMIC_RELEASE);
+    futexWake(&mSeq, INT_MAX, mShared);
+}
+
+#elif defined(HAVE_PTHREADS)
 
 inline Condition::Condition() {
-    pthread_cond_init(&mCond, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&mCond, &attr);
+    pthread_condattr_destroy(&attr);
 }
 inline Condition::Condition(int type) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
     if (type == SHARED) {
-        pthread_condattr_t attr;
-        pthread_condattr_init(&attr);
         pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-        pthread_cond_init(&mCond, &attr);
-        pthread_condattr_destroy(&attr);
-    } else {
-        pthread_cond_init(&mCond, NULL);
     }
+    pthread_cond_init(&mCond, &attr);
+    pthread_condattr_destroy(&attr);
 }
 inline Condition::~Condition() {
     pthread_cond_destroy(&mCond);
@@ -100,16 +165,9 @@ inline status_t Condition::waitRelative(Mutex& mutex, nsecs_t reltime) {
     ts.tv_nsec = reltime%1000000000;
     return -pthread_cond_timedwait_relative_np(&mCond, &mutex.mMutex, &ts);
 #else // HAVE_PTHREAD_COND_TIMEDWAIT_RELATIVE
+    // the condition is bound to CLOCK_MONOTONIC in the constructor
     struct timespec ts;
-#if defined(HAVE_POSIX_CLOCKS)
-    clock_gettime(CLOCK_REALTIME, &ts);
-#else // HAVE_POSIX_CLOCKS
-    // we don't support the clocks here.
-    struct timeval t;
-    gettimeofday(&t, NULL);
-    ts.tv_sec = t.tv_sec;
-    ts.tv_nsec= t.tv_usec*1000;
-#endif // HAVE_POSIX_CLOCKS
+    clock_gettime(CLOCK_MONOTONIC, &ts);
     ts.tv_sec += reltime/1000000000;
     ts.tv_nsec+= reltime%1000000000;
     if (ts.tv_nsec >= 1000000000) {
@@ -119,6 +177,15 @@ inline status_t Condition::waitRelative(Mutex& mutex, nsecs_t reltime) {
     return -pthread_cond_timedwait(&mCond, &mutex.mMutex, &ts);
 #endif // HAVE_PTHREAD_COND_TIMEDWAIT_RELATIVE
 }
+inline status_t Condition::waitUntil(Mutex& mutex, nsecs_t monotonicDeadline) {
+    struct timespec ts;
+    if (monotonicDeadline < 0) {
+        monotonicDeadline = 0;
+    }
+    ts.tv_sec  = monotonicDeadline/1000000000;
+    ts.tv_nsec = monotonicDeadline%1000000000;
+    return -pthread_cond_timedwait(&mCond, &mutex.mMutex, &ts);
+}
 inline void Condition::signal() {
     pthread_cond_signal(&mCond);
 }
@@ -126,7 +193,7 @@ inline void Condition::broadcast() {
     pthread_cond_broadcast(&mCond);
 }
 
-#endif // HAVE_PTHREADS
+#endif // HAVE_FUTEX_MUTEX
 
 // ---------------------------------------------------------------------------
 }; // namespace ThreadManager
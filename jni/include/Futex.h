@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Thin wrappers over the futex system call, for the lock primitives.
+ */
+
+#ifndef _LIBS_UTILS_FUTEX_H
+#define _LIBS_UTILS_FUTEX_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifndef FUTEX_PRIVATE_FLAG
+#define FUTEX_PRIVATE_FLAG 128
+#endif
+
+// ---------------------------------------------------------------------------
+namespace ThreadManager {
+// ---------------------------------------------------------------------------
+
+// Sleep while *addr == value, for at most the relative timeout (NULL means
+// forever).  Returns 0 when woken, or -errno (-EAGAIN if *addr != value,
+// -ETIMEDOUT, -EINTR).
+inline int futexWait(volatile int32_t* addr, int32_t value,
+                     const struct timespec* timeout, bool shared = false) {
+    int op = FUTEX_WAIT | (shared ? 0 : FUTEX_PRIVATE_FLAG);
+    if (syscall(__NR_futex, addr, op, value, timeout, NULL, 0) == -1) {
+        return -errno;
+    }
+    return 0;
+}
+
+// Same, but the timeout is an absolute CLOCK_MONOTONIC time.
+inline int futexWaitUntil(volatile int32_t* addr, int32_t value,
+                          const struct timespec* deadline, bool shared = false) {
+    int op = FUTEX_WAIT_BITSET | (shared ? 0 : FUTEX_PRIVATE_FLAG);
+    if (syscall(__NR_futex, addr, op, value, deadline, NULL,
+            FUTEX_BITSET_MATCH_ANY) == -1) {
+        return -errno;
+    }
+    return 0;
+}
+
+// Wake up to count threads sleeping on addr.  Returns the number woken.
+inline int futexWake(volatile int32_t* addr, int count, bool shared = false) {
+    int op = FUTEX_WAKE | (shared ? 0 : FUTEX_PRIVATE_FLAG);
+    return syscall(__NR_futex, addr, op, count, NULL, NULL, 0);
+}
+
+// Tell the CPU we are spinning.
+inline void cpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+// ---------------------------------------------------------------------------
+}; // namespace ThreadManager
+// ---------------------------------------------------------------------------
+
+#endif // _LIBS_UTILS_FUTEX_H
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_UTILS_HISTOGRAM_H
+#define _LIBS_UTILS_HISTOGRAM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "Timers.h"
+
+// ---------------------------------------------------------------------------
+namespace ThreadManager {
+// ---------------------------------------------------------------------------
+
+/*
+ * Log-linear histogram of durations, in the style of HdrHistogram.
+ *
+ * Every power of two is split into 16 linear sub-buckets, so a bucket is
+ * never wider than 1/16 of its lower bound and percentiles come out within
+ * about 6%.  Values from 0 to 2^41ns (about 36 minutes) are tracked; larger
+ * ones land in the last bucket.
+ *
+ * One thread records; any thread may merge() a copy out at the same time.
+ * The copy may be off by the records still in flight, nothing more.
+ */
+class Histogram {
+public:
+    enum {
+        SUB_BUCKET_BITS = 4,
+        SUB_BUCKETS     = 1 << SUB_BUCKET_BITS,
+        MAX_EXPONENT    = 40,
+        BUCKETS         = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS,
+    };
+
+    inline Histogram() { reset(); }
+
+    // Records one value.  Negative values count as 0.
+    inline void record(nsecs_t value) {
+        if (value < 0) {
+            value = 0;
+        }
+        int bucket = bucketOf(value);
+        __atomic_store_n(&mBuckets[bucket], mBuckets[bucket] + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&mTotal, mTotal + value, __ATOMIC_RELAXED);
+        if (value > mMax) {
+            __atomic_store_n(&mMax, value, __ATOMIC_RELAXED);
+        }
+        if (value < mMin || mCount == 0) {
+            __atomic_store_n(&mMin, value, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&mCount, mCount + 1, __ATOMIC_RELAXED);
+    }
+
+    // Adds everything recorded in other to this histogram.
+    void        merge(const Histogram& other);
+    void        reset();
+
+    inline uint64_t count() const { return __atomic_load_n(&mCount, __ATOMIC_RELAXED); }
+    inline nsecs_t  min() const   { return count() ? __atomic_load_n(&mMin, __ATOMIC_RELAXED) : 0; }
+    inline nsecs_t  max() const   { return __atomic_load_n(&mMax, __ATOMIC_RELAXED); }
+    nsecs_t     mean() const;
+
+    // Smallest value that at least p percent of the records do not exceed,
+    // rounded up to the end of its bucket.  0 when empty.
+    nsecs_t     percentile(double p) const;
+
+    // One line: label, count, mean, p50/p90/p99/p99.9 and max.
+    void        dump(int fd, const char* label) const;
+
+    static inline int bucketOf(nsecs_t value) {
+        if (value < SUB_BUCKETS) {
+            return (int) value;
+        }
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent > MAX_EXPONENT) {
+            return BUCKETS - 1;
+        }
+        int shift = exponent - SUB_BUCKET_BITS;
+        return ((shift + 1) << SUB_BUCKET_BITS) + (int) ((value >> shift) - SUB_BUCKETS);
+    }
+
+    // First value that falls into bucket.
+    static nsecs_t lowestValueOf(int bucket);
+
+private:
+    volatile uint64_t mCount;
+    volatile nsecs_t  mTotal;
+    volatile nsecs_t  mMin;
+    volatile nsecs_t  mMax;
+    volatile uint32_t mBuckets[BUCKETS];
+};
+
+// ---------------------------------------------------------------------------
+}; // namespace ThreadManager
+// ---------------------------------------------------------------------------
+
+#endif // _LIBS_UTILS_HISTOGRAM_H
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Binary trace of the message lifecycle: send, enqueue, wake, poll,
+ *  dequeue and dispatch.  Each thread appends fixed-size records to its own
+ *  ring, overwriting the oldest once full, so tracing never blocks and keeps
+ *  the most recent history.  The rings are exported as Chrome trace JSON,
+ *  which chrome://tracing and ui.perfetto.dev both load.
+ */
+
+#ifndef _LIBS_UTILS_MESSAGE_TRACE_H
+#define _LIBS_UTILS_MESSAGE_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    MESSAGE_TRACE_SEND = 1,         // handler accepted a message to send
+    MESSAGE_TRACE_ENQUEUE,          // message is in the queue
+    MESSAGE_TRACE_WAKE,             // poller woken for new work
+    MESSAGE_TRACE_POLL_BEGIN,       // looper goes to sleep in epoll_wait
+    MESSAGE_TRACE_POLL_END,         // looper is back; what = event count
+    MESSAGE_TRACE_DEQUEUE,          // message taken off the queue
+    MESSAGE_TRACE_DISPATCH_BEGIN,   // handler starts on the message
+    MESSAGE_TRACE_DISPATCH_END      // handler is done with it
+};
+
+// Non-zero while tracing; read by MESSAGE_TRACE().
+extern int32_t gMessageTracing;
+
+// Records one event for the calling thread.  Use MESSAGE_TRACE() instead.
+void androidMessageTrace(int32_t event, const void* message,
+                         const void* handler, int32_t what);
+
+// Start or stop recording.  Stopping keeps the rings for export.
+void androidSetMessageTracing(int enable);
+
+// Records per thread ring, rounded up to a power of two.  Only rings
+// created afterwards use the new size.  Default 4096.
+void androidSetMessageTraceBufferSize(size_t records);
+
+// Forget everything recorded so far.  Call with tracing stopped.
+void androidResetMessageTrace(void);
+
+// Write the recorded events to fd as Chrome trace JSON.  Call with tracing
+// stopped for an exact snapshot; otherwise records being overwritten while
+// they are exported may come out garbled.  Returns the number of events.
+size_t androidExportMessageTrace(int fd);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+// Costs a single predictable branch while tracing is off.
+#define MESSAGE_TRACE(event, message, handler, what) \
+    do { \
+        if (__builtin_expect(__atomic_load_n(&gMessageTracing, __ATOMIC_RELAXED), 0)) { \
+            androidMessageTrace((event), (message), (handler), (what)); \
+        } \
+    } while (0)
+
+#endif // _LIBS_UTILS_MESSAGE_TRACE_H
@@ -17,10 +17,18 @@
 
 #pragma once
 #include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#if defined(HAVE_FUTEX_MUTEX)
+#include "Futex.h"
+#endif
 
 namespace ThreadManager{
 
 class Condition;
+struct MutexProfile;
 
 class Mutex
 {
@@ -37,6 +45,19 @@ public:
     Mutex ();
 
 
+    /*******************************************************************************
+    **
+    ** Function:        Mutex
+    **
+    ** Description:     Initialize member variables.  The name labels the
+    **                  mutex in contention dumps; it is not copied.
+    **
+    ** Returns:         None.
+    **
+    *******************************************************************************/
+    explicit Mutex (const char* name);
+
+
     /*******************************************************************************
     **
     ** Function:        ~Mutex
@@ -85,6 +106,7 @@ public:
     bool tryLock ();
 
 
+#if !defined(HAVE_FUTEX_MUTEX)
     /*******************************************************************************
     **
     ** Function:        nativeHandle
@@ -95,6 +117,49 @@ public:
     **
     *******************************************************************************/
     pthread_mutex_t* nativeHandle ();
+#endif
+
+
+    /*******************************************************************************
+    **
+    ** Function:        setContentionProfiling
+    **
+    ** Description:     Turn the contention profiler on or off for all mutexes.
+    **                  While on, lock() records how long it had to wait, the
+    **                  thread that held the mutex and the call site.  While
+    **                  off, lock() pays a single branch.
+    **
+    ** Returns:         None.
+    **
+    *******************************************************************************/
+    static void setContentionProfiling (bool enable);
+
+
+    /*******************************************************************************
+    **
+    ** Function:        resetContentionProfile
+    **
+    ** Description:     Clear the statistics gathered so far.
+    **
+    ** Returns:         None.
+    **
+    *******************************************************************************/
+    static void resetContentionProfile ();
+
+
+    /*******************************************************************************
+    **
+    ** Function:        dumpContention
+    **
+    ** Description:     Write the contended mutexes to fd, most total wait
+    **                  first, with a wait-time histogram and the hottest
+    **                  call sites of each.  maxLocks limits the output,
+    **                  0 means all.
+    **
+    ** Returns:         None.
+    **
+    *******************************************************************************/
+    static void dumpContention (int fd, size_t maxLocks = 0);
 
     class Autolock {
         public:
@@ -108,8 +173,95 @@ public:
 
 private:
 	friend class Condition;
+
+    // A copy is never what the caller wants.
+    Mutex (const Mutex&);
+    Mutex& operator = (const Mutex&);
+
+    /*******************************************************************************
+    **
+    ** Function:        lockProfiled
+    **
+    ** Description:     lock() while the profiler is on: try-lock first, and
+    **                  on contention time the wait and record it.  site is
+    **                  the caller's return address, or NULL to take our own.
+    **
+    ** Returns:         None.
+    **
+    *******************************************************************************/
+    void lockProfiled (void* site) __attribute__((noinline));
+
+    void releaseProfile ();
+
+    const char* mName;
+    MutexProfile* volatile mProfile;  // allocated on first contention
+    volatile pid_t mOwner;            // last holder seen by lockProfiled
+
+#if defined(HAVE_FUTEX_MUTEX)
+    /*******************************************************************************
+    **
+    ** Function:        lockContended
+    **
+    ** Description:     Spin for a while, then sleep on the futex until the
+    **                  mutex is released.
+    **
+    ** Returns:         None.
+    **
+    *******************************************************************************/
+    void lockContended ();
+
+    enum {
+        UNLOCKED    = 0,
+        LOCKED      = 1,    // no other thread is sleeping on mState
+        CONTENDED   = 2,    // unlock() must wake a sleeper
+    };
+    volatile int32_t mState;
+    int32_t mSpinLimit;     // adaptive spin budget, updated without a lock
+#else
     pthread_mutex_t mMutex;
+#endif
 };
 
 typedef Mutex::Autolock AutoMutex;
+
+// Non-zero while the contention profiler is on.
+extern int32_t gMutexProfiling;
+
+#if defined(HAVE_FUTEX_MUTEX)
+// The uncontended paths are a single atomic instruction, inlined.
+
+inline Mutex::Mutex()
+    : mName(NULL), mProfile(NULL), mOwner(0), mState(UNLOCKED), mSpinLimit(0) {
+}
+inline Mutex::Mutex(const char* name)
+    : mName(name), mProfile(NULL), mOwner(0), mState(UNLOCKED), mSpinLimit(0) {
+}
+inline Mutex::~Mutex() {
+    if (mProfile != NULL) {
+        releaseProfile();
+    }
+}
+inline void Mutex::lock() {
+    if (__builtin_expect(__atomic_load_n(&gMutexProfiling, __ATOMIC_RELAXED), 0)) {
+        lockProfiled(NULL);
+        return;
+    }
+    int32_t expected = UNLOCKED;
+    if (__atomic_compare_exchange_n(&mState, &expected, LOCKED, false,
+            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    lockContended();
+}
+inline void Mutex::unlock() {
+    if (__atomic_exchange_n(&mState, UNLOCKED, __ATOMIC_RELEASE) == CONTENDED) {
+        futexWake(&mState, 1);
+    }
+}
+inline bool Mutex::tryLock() {
+    int32_t expected = UNLOCKED;
+    return __atomic_compare_exchange_n(&mState, &expected, LOCKED, false,
+            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+#endif // HAVE_FUTEX_MUTEX
 }
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_UTILS_RWLOCK_H
+#define _LIBS_UTILS_RWLOCK_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "Errors.h"
+#include "Futex.h"
+#include "Mutex.h"
+
+// ---------------------------------------------------------------------------
+namespace ThreadManager {
+// ---------------------------------------------------------------------------
+
+/*
+ * Simple writer-preferring reader-writer lock, built on a futex word.
+ *
+ * Any number of readers may hold the lock at once.  As soon as a writer asks
+ * for it, new readers are held back until every queued writer is done, so a
+ * steady stream of readers cannot starve writers.  Not recursive: a reader
+ * that asks for the lock again while a writer is waiting deadlocks.
+ */
+class RWLock {
+public:
+                RWLock();
+                ~RWLock();
+
+    status_t    readLock();
+    status_t    tryReadLock();
+    status_t    writeLock();
+    status_t    tryWriteLock();
+    void        unlock();
+
+    class AutoRLock {
+    public:
+        inline AutoRLock(RWLock& rwlock) : mLock(rwlock)  { mLock.readLock(); }
+        inline ~AutoRLock() { mLock.unlock(); }
+    private:
+        RWLock& mLock;
+    };
+
+    class AutoWLock {
+    public:
+        inline AutoWLock(RWLock& rwlock) : mLock(rwlock)  { mLock.writeLock(); }
+        inline ~AutoWLock() { mLock.unlock(); }
+    private:
+        RWLock& mLock;
+    };
+
+private:
+    // A copy is never what the caller wants.
+                RWLock(const RWLock&);
+    RWLock&     operator = (const RWLock&);
+
+    void        readLockContended();
+    void        readUnlock();
+    void        writeUnlock();
+
+    enum {
+        // set while a writer holds the lock or waits for readers to drain
+        WRITER          = 1 << 30,
+        READERS_MASK    = WRITER - 1,
+    };
+
+    volatile int32_t mState;    // WRITER | number of readers
+    volatile int32_t mWriters;  // writers holding or queued for the lock
+    Mutex       mWriterLock;    // serialises writers
+};
+
+// ---------------------------------------------------------------------------
+
+inline status_t RWLock::readLock() {
+    int32_t s = __atomic_load_n(&mState, __ATOMIC_RELAXED);
+    if (!(s & WRITER) && __atomic_compare_exchange_n(&mState, &s, s + 1, false,
+            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return NO_ERROR;
+    }
+    readLockContended();
+    return NO_ERROR;
+}
+
+inline void RWLock::unlock() {
+    // Readers and a writer never hold the lock together, so the reader count
+    // tells who is unlocking.
+    if (__atomic_load_n(&mState, __ATOMIC_RELAXED) & READERS_MASK) {
+        readUnlock();
+    } else {
+        writeUnlock();
+    }
+}
+
+// ---------------------------------------------------------------------------
+}; // namespace ThreadManager
+// ---------------------------------------------------------------------------
+
+#endif // _LIBS_UTILS_RWLOCK_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_UTILS_SEQLOCK_H
+#define _LIBS_UTILS_SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "Futex.h"
+#include "Mutex.h"
+
+// ---------------------------------------------------------------------------
+namespace ThreadManager {
+// ---------------------------------------------------------------------------
+
+/*
+ * Sequence lock around a small value of type T.
+ *
+ * Readers never block writers and never write to shared memory: they copy
+ * the value and retry if a writer got in meanwhile.  Meant for data that is
+ * read far more often than it changes (timestamps, counters, configuration).
+ * T must be trivially copyable, since readers may copy a torn value before
+ * throwing it away.
+ */
+template <typename T>
+class SeqLock {
+public:
+    SeqLock() : mSeq(0) { memset((void*)&mValue, 0, sizeof(T)); }
+    explicit SeqLock(const T& value) : mSeq(0), mValue(value) { }
+
+    // Returns a consistent copy of the value.
+    inline T read() const {
+        T value;
+        read(&value);
+        return value;
+    }
+
+    inline void read(T* out) const {
+        for (;;) {
+            uint32_t seq = __atomic_load_n(&mSeq, __ATOMIC_ACQUIRE);
+            if (seq & 1) {
+                // write in progress
+                cpuRelax();
+                continue;
+            }
+            memcpy((void*)out, (const void*)&mValue, sizeof(T));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&mSeq, __ATOMIC_RELAXED) == seq) {
+                return;
+            }
+        }
+    }
+
+    inline void write(const T& value) {
+        AutoWrite _w(*this);
+        _w.value() = value;
+    }
+
+    // Scoped write access; writers are serialised between themselves.
+    class AutoWrite {
+    public:
+        inline AutoWrite(SeqLock& seqlock) : mLock(seqlock) {
+            mLock.mWriteLock.lock();
+            __atomic_store_n(&mLock.mSeq, mLock.mSeq + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+        }
+        inline ~AutoWrite() {
+            __atomic_store_n(&mLock.mSeq, mLock.mSeq + 1, __ATOMIC_RELEASE);
+            mLock.mWriteLock.unlock();
+        }
+        inline T& value() { return mLock.mValue; }
+    private:
+        SeqLock& mLock;
+    };
+
+private:
+    // A copy is never what the caller wants.
+    SeqLock(const SeqLock&);
+    SeqLock& operator = (const SeqLock&);
+
+    volatile uint32_t   mSeq;       // odd while a write is in progress
+    T                   mValue;
+    Mutex               mWriteLock;
+};
+
+// ---------------------------------------------------------------------------
+}; // namespace ThreadManager
+// ---------------------------------------------------------------------------
+
+#endif // _LIBS_UTILS_SEQLOCK_H
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_UTILS_SMALLFUNCTION_H
+#define _LIBS_UTILS_SMALLFUNCTION_H
+
+#include <stddef.h>
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// ---------------------------------------------------------------------------
+namespace ThreadManager {
+// ---------------------------------------------------------------------------
+
+template <typename Signature, size_t Capacity = 3 * sizeof(void*)>
+class SmallFunction;
+
+/*
+ * Move-only callable wrapper, like std::function without the allocation.
+ *
+ * A callable of up to Capacity bytes that can be moved without throwing is
+ * kept inside the object; only bigger ones go to the heap.  Dispatch goes
+ * through a static table per callable type, so no RTTI is needed.  Calling
+ * an empty SmallFunction is a bug.
+ */
+template <typename R, typename... Args, size_t Capacity>
+class SmallFunction<R(Args...), Capacity> {
+public:
+    SmallFunction() : mOps(NULL) { }
+
+    template <typename F, typename = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+    SmallFunction(F&& f) : mOps(NULL) {
+        assign(std::forward<F>(f));
+    }
+
+    SmallFunction(SmallFunction&& other) noexcept : mOps(NULL) {
+        moveFrom(other);
+    }
+
+    SmallFunction& operator = (SmallFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~SmallFunction() { reset(); }
+
+    inline explicit operator bool () const { return mOps != NULL; }
+
+    inline R operator () (Args... args) {
+        return mOps->invoke(mStorage, std::forward<Args>(args)...);
+    }
+
+    // Destroy the callable, leaving this empty.
+    inline void reset() {
+        if (mOps != NULL) {
+            mOps->destroy(mStorage);
+            mOps = NULL;
+        }
+    }
+
+    // Whether the callable lives inside this object rather than the heap.
+    inline bool isInline() const { return mOps != NULL && mOps->isInline; }
+
+    template <typename F>
+    static constexpr bool fitsInline() {
+        return sizeof(F) <= Capacity
+                && alignof(F) <= alignof(std::max_align_t)
+                && std::is_nothrow_move_constructible<F>::value;
+    }
+
+private:
+    struct Ops {
+        R (*invoke)(void* storage, Args&&... args);
+        void (*move)(void* from, void* to);
+        void (*destroy)(void* storage);
+        bool isInline;
+    };
+
+    template <typename F>
+    struct InlineOps {
+        static R invoke(void* storage, Args&&... args) {
+            return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+        }
+        static void move(void* from, void* to) {
+            new (to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        }
+        static void destroy(void* storage) {
+            static_cast<F*>(storage)->~F();
+        }
+        static const Ops* ops() {
+            static const Ops sOps = { invoke, move, destroy, true };
+            return &sOps;
+        }
+    };
+
+    template <typename F>
+    struct HeapOps {
+        static R invoke(void* storage, Args&&... args) {
+            return (**static_cast<F**>(storage))(std::forward<Args>(args)...);
+        }
+        static void move(void* from, void* to) {
+            *static_cast<F**>(to) = *static_cast<F**>(from);
+        }
+        static void destroy(void* storage) {
+            delete *static_cast<F**>(storage);
+        }
+        static const Ops* ops() {
+            static const Ops sOps = { invoke, move, destroy, false };
+            return &sOps;
+        }
+    };
+
+    template <typename F>
+    void assign(F&& f) {
+        typedef typename std::decay<F>::type Callable;
+        assign<Callable>(std::forward<F>(f),
+                std::integral_constant<bool, fitsInline<Callable>()>());
+    }
+
+    template <typename Callable, typename F>
+    void assign(F&& f, std::true_type /* inline */) {
+        new (mStorage) Callable(std::forward<F>(f));
+        mOps = InlineOps<Callable>::ops();
+    }
+
+    template <typename Callable, typename F>
+    void assign(F&& f, std::false_type /* inline */) {
+        Callable* callable = new Callable(std::forward<F>(f));
+        if (callable == NULL) {
+            return;
+        }
+        *reinterpret_cast<Callable**>(mStorage) = callable;
+        mOps = HeapOps<Callable>::ops();
+    }
+
+    inline void moveFrom(SmallFunction& other) {
+        if (other.mOps != NULL) {
+            other.mOps->move(other.mStorage, mStorage);
+            mOps = other.mOps;
+            other.mOps = NULL;
+        }
+    }
+
+    // Not copyable: the callable may not be.
+    SmallFunction(const SmallFunction&);
+    SmallFunction& operator = (const SmallFunction&);
+
+    static_assert(Capacity >= sizeof(void*), "room for the heap pointer");
+
+    alignas(std::max_align_t) unsigned char mStorage[Capacity];
+    const Ops* mOps;
+};
+
+// ---------------------------------------------------------------------------
+}; // namespace ThreadManager
+// ---------------------------------------------------------------------------
+
+#endif // _LIBS_UTILS_SMALLFUNCTION_H
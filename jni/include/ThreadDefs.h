@@ -75,6 +75,43 @@ enum {
     ANDROID_PRIORITY_LESS_FAVORABLE = +1,
 };
 
+enum {
+    /*
+     * Kernel scheduling classes a thread can be placed in, see
+     * android_thread_sched_t below.
+     */
+
+    /* time-sharing (SCHED_OTHER); only the nice level is used */
+    ANDROID_SCHED_NORMAL            =   0,
+
+    /* real-time first-in first-out (SCHED_FIFO) */
+    ANDROID_SCHED_FIFO              =   1,
+
+    /* real-time round-robin (SCHED_RR) */
+    ANDROID_SCHED_RR                =   2,
+
+    /* earliest deadline first (SCHED_DEADLINE), set with sched_setattr */
+    ANDROID_SCHED_DEADLINE          =   3,
+};
+
+/*
+ * Scheduling-policy descriptor for a thread.
+ *
+ * "priority" is the real-time priority (1..99) used by ANDROID_SCHED_FIFO and
+ * ANDROID_SCHED_RR.  "nice" is one of the ANDROID_PRIORITY constants; it is the
+ * priority of an ANDROID_SCHED_NORMAL thread, and the level a real-time or
+ * deadline request falls back to when the kernel refuses it (usually EPERM).
+ * The runtime/deadline/period triple is only used by ANDROID_SCHED_DEADLINE.
+ */
+typedef struct android_thread_sched_t {
+    int32_t     policy;
+    int32_t     priority;
+    int32_t     nice;
+    uint64_t    runtimeNs;
+    uint64_t    deadlineNs;
+    uint64_t    periodNs;
+} android_thread_sched_t;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -103,6 +140,35 @@ enum {
     PRIORITY_LESS_FAVORABLE = ANDROID_PRIORITY_LESS_FAVORABLE,
 };
 
+enum {
+    THREAD_SCHED_NORMAL     = ANDROID_SCHED_NORMAL,
+    THREAD_SCHED_FIFO       = ANDROID_SCHED_FIFO,
+    THREAD_SCHED_RR         = ANDROID_SCHED_RR,
+    THREAD_SCHED_DEADLINE   = ANDROID_SCHED_DEADLINE,
+};
+
+typedef android_thread_sched_t thread_sched_t;
+
+// Helpers to fill in a thread_sched_t.
+inline thread_sched_t schedNormal(int32_t nice = PRIORITY_DEFAULT) {
+    thread_sched_t s = { THREAD_SCHED_NORMAL, 0, nice, 0, 0, 0 };
+    return s;
+}
+
+inline thread_sched_t schedRealtime(int32_t policy, int32_t rtPriority,
+                                    int32_t fallbackNice = PRIORITY_URGENT_AUDIO) {
+    thread_sched_t s = { policy, rtPriority, fallbackNice, 0, 0, 0 };
+    return s;
+}
+
+inline thread_sched_t schedDeadline(uint64_t runtimeNs, uint64_t deadlineNs,
+                                    uint64_t periodNs, int32_t fallbackRtPriority = 0,
+                                    int32_t fallbackNice = PRIORITY_URGENT_AUDIO) {
+    thread_sched_t s = { THREAD_SCHED_DEADLINE, fallbackRtPriority, fallbackNice,
+                         runtimeNs, deadlineNs, periodNs };
+    return s;
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace ThreadManager
 #endif  // __cplusplus
@@ -76,9 +76,20 @@ enum {
     SYSTEM_TIME_MONOTONIC = 1, // monotonic time since unspecified starting point
     SYSTEM_TIME_PROCESS = 2,   // high-resolution per-process clock
     SYSTEM_TIME_THREAD = 3,    // high-resolution per-thread clock
-    SYSTEM_TIME_BOOTTIME = 4   // same as SYSTEM_TIME_MONOTONIC, but including CPU suspend time
+    SYSTEM_TIME_BOOTTIME = 4,  // same as SYSTEM_TIME_MONOTONIC, but including CPU suspend time
+    SYSTEM_TIME_MONOTONIC_COARSE = 5, // SYSTEM_TIME_MONOTONIC at tick (1-10ms) resolution, cheaper
+    SYSTEM_TIME_FAST = 6       // SYSTEM_TIME_MONOTONIC extrapolated from the CPU cycle counter
 };
 
+/*
+ * SYSTEM_TIME_FAST reads the counter directly (cntvct_el0 on arm64, an
+ * invariant TSC on x86_64) and scales it against CLOCK_MONOTONIC, calibrated
+ * on first use.  It shares the monotonic time base but may drift from it by
+ * some ppm, so use it to time intervals on hot paths, not for deadlines
+ * handed to the kernel.  Where no usable counter exists it is the same as
+ * SYSTEM_TIME_MONOTONIC.
+ */
+
 // return the system-time according to the specified clock
 #ifdef __cplusplus
 nsecs_t systemTime(int clock = SYSTEM_TIME_MONOTONIC);
@@ -106,6 +117,10 @@ int toMillisecondTimeoutDelay(nsecs_t referenceTime, nsecs_t timeoutTime);
 #ifdef __cplusplus
 
 namespace ThreadManager {
+
+// Write ns to buf as "850ns", "12.3us", "4.56ms" or "1.234s", for dumps.
+void formatDuration(char* buf, size_t size, nsecs_t ns);
+
 /*
  * Time the duration of something.
  *
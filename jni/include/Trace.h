@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Sections in the kernel trace.  While enabled, ATRACE_* write the atrace
+ *  "B|pid|name" / "E|pid" records to the ftrace trace_marker, so looper
+ *  activity lines up with scheduling events in systrace and Perfetto.
+ */
+
+#ifndef _LIBS_UTILS_TRACE_H
+#define _LIBS_UTILS_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Non-zero while sections are written; read by the ATRACE_* macros.
+extern int32_t gTraceMarkerEnabled;
+
+// Turn tracing on or off.  The trace_marker file is opened the first time
+// and kept open.  Returns 0, or -errno if it cannot be opened.
+int androidSetTraceMarker(int enable);
+
+// Unconditional writes; use the macros below instead.
+void androidTraceBegin(const char* name);
+void androidTraceEnd(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+// Acquire pairs with the release in androidSetTraceMarker(), so the writers
+// see the trace_marker fd and pid it set up.
+#define ATRACE_ENABLED() \
+    __builtin_expect(__atomic_load_n(&gTraceMarkerEnabled, __ATOMIC_ACQUIRE), 0)
+
+#define ATRACE_BEGIN(name) \
+    do { if (ATRACE_ENABLED()) androidTraceBegin(name); } while (0)
+
+#define ATRACE_END() \
+    do { if (ATRACE_ENABLED()) androidTraceEnd(); } while (0)
+
+#ifdef __cplusplus
+
+// Traces the enclosing scope.  Whether to close the section is decided at
+// the start, so toggling in between never leaves an unmatched record.
+#define ATRACE_NAME(name) ThreadManager::ScopedTrace ___tracer(name)
+
+namespace ThreadManager {
+
+class ScopedTrace {
+public:
+    inline ScopedTrace(const char* name) : mActive(ATRACE_ENABLED()) {
+        if (mActive) {
+            androidTraceBegin(name);
+        }
+    }
+    inline ~ScopedTrace() {
+        if (mActive) {
+            androidTraceEnd();
+        }
+    }
+private:
+    bool mActive;
+};
+
+}; // namespace ThreadManager
+#endif // __cplusplus
+
+#endif // _LIBS_UTILS_TRACE_H
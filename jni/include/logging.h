@@ -11,6 +11,8 @@
  */
 
 
+#pragma once
+
 #define LOG_TAG "THREAD_MANAGER"
 
 #include "util.h"
@@ -19,33 +21,71 @@
 
 //namespace ThreadManager{
 
-#ifdef ANDROID // set to 0 to print directly to console
+// Log priorities as plain numbers (they match android_LogPriority), so the
+// preprocessor can compare them.
+#define LOG_LEVEL_VERBOSE	2
+#define LOG_LEVEL_DEBUG		3
+#define LOG_LEVEL_INFO		4
+#define LOG_LEVEL_WARN		5
+#define LOG_LEVEL_ERROR		6
+
+// Lowest priority compiled in.  Calls below it expand to nothing, arguments
+// included.  Override with LOCAL_CFLAGS += -DLOG_MIN_LEVEL=LOG_LEVEL_DEBUG.
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL		LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL		LOG_LEVEL_VERBOSE
+#endif
+#endif
 
-#define LOG_NDDEBUG		0	// ALOGD
-#define LOG_NDEBUG		0	// ALOGV
-#define LOG_NIDEBUG		0	// ALOGI
+#ifdef ANDROID // set to 0 to print directly to console
+#include "AsyncLog.h"
 
 #define __XLOG(lvl, ...) \
-  __android_log_print(lvl, LOG_TAG, __VA_ARGS__)
+  androidLogPrint(lvl, LOG_TAG, __VA_ARGS__)
 #else
 #include <stdio.h>
 #define __XLOG(lvl, ...) \
   printf(__VA_ARGS__); printf("\n");
 #endif
 
+#define __XLOG_NONE(...) \
+	((void)0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
 #define ALOGE(...) \
 	__XLOG(ANDROID_LOG_ERROR, __VA_ARGS__)
-	
+#else
+#define ALOGE __XLOG_NONE
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
 #define ALOGW(...) \
 	__XLOG(ANDROID_LOG_WARN, __VA_ARGS__)
-	
+#else
+#define ALOGW __XLOG_NONE
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
 #define ALOGI(...) \
 	__XLOG(ANDROID_LOG_INFO, __VA_ARGS__)
+#else
+#define ALOGI __XLOG_NONE
+#endif
 
+#if LOG_MIN_LEVEL <= LOG_LEVEL_VERBOSE
 #define ALOGV(...) \
 	__XLOG(ANDROID_LOG_VERBOSE, __VA_ARGS__)
+#else
+#define ALOGV __XLOG_NONE
+#endif
 
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
 #define ALOGD(...) \
 	__XLOG(ANDROID_LOG_DEBUG, __VA_ARGS__)
+#else
+#define ALOGD __XLOG_NONE
+#endif
 
 //}//namespace ThreadManager
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Asynchronous logging.
+ *
+ *  Each logging thread owns a single-producer/single-consumer ring of
+ *  fixed-size records.  The producer formats straight into its slot and
+ *  publishes it by moving the tail; the drain thread is the only consumer.
+ *  Rings are never freed: a thread that exits gives its ring back and the
+ *  next new thread adopts it, so memory is bounded by the peak number of
+ *  logging threads.  A full ring drops the record and counts it rather
+ *  than block the caller.
+ *
+ *  This file must not log through ALOGx itself; it talks to logd directly.
+ */
+
+#include "AsyncLog.h"
+#include "logging.h"
+#include "Futex.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+
+using namespace ThreadManager;
+
+enum {
+    LOG_RING_SIZE   = 64,   // records per thread, a power of two
+    LOG_TEXT_MAX    = 256,  // longer messages are truncated
+};
+
+// How long the drain thread sleeps when nobody wakes it.
+static const long DRAIN_INTERVAL_NS = 10000000L;
+
+struct LogRecord {
+    int32_t     prio;
+    const char* tag;
+    char        text[LOG_TEXT_MAX];
+};
+
+struct LogRing {
+    LogRing*            next;       // all rings, linked once, never unlinked
+    volatile int32_t    owned;      // 1 while a thread logs into the ring
+    volatile uint32_t   head;       // next record to drain; drain thread only
+    volatile uint32_t   tail;       // next record to fill; owner only
+    volatile uint32_t   dropped;    // records lost to a full ring
+    LogRecord           records[LOG_RING_SIZE];
+};
+
+static LogRing* volatile gRings = NULL;
+static pthread_key_t gRingKey;
+static pthread_once_t gRingKeyOnce = PTHREAD_ONCE_INIT;
+
+static int32_t gAsyncLogging = 0;
+// Serialises consumers (the drain thread and androidFlushAsyncLog).
+static pthread_mutex_t gDrainLock = PTHREAD_MUTEX_INITIALIZER;
+// Serialises androidSetAsyncLogging.
+static pthread_mutex_t gControlLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t gDrainThread;
+static bool gDrainThreadRunning = false;
+// Bumped to wake the drain thread early.
+static volatile int32_t gDrainSignal = 0;
+
+static void releaseRing(void* ring)
+{
+    __atomic_store_n(&((LogRing*) ring)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void initRingKey()
+{
+    pthread_key_create(&gRingKey, releaseRing);
+}
+
+static LogRing* adoptRing()
+{
+    LogRing* ring = __atomic_load_n(&gRings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        int32_t expected = 0;
+        if (__atomic_load_n(&ring->owned, __ATOMIC_RELAXED) == 0
+                && __atomic_compare_exchange_n(&ring->owned, &expected, 1, false,
+                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return ring;
+        }
+    }
+
+    ring = (LogRing*) calloc(1, sizeof(LogRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->owned = 1;
+    LogRing* head = __atomic_load_n(&gRings, __ATOMIC_RELAXED);
+    do {
+        ring->next = head;
+    } while (!__atomic_compare_exchange_n(&gRings, &head, ring, true,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return ring;
+}
+
+static LogRing* ringForThread()
+{
+    pthread_once(&gRingKeyOnce, initRingKey);
+    LogRing* ring = (LogRing*) pthread_getspecific(gRingKey);
+    if (ring == NULL) {
+        ring = adoptRing();
+        pthread_setspecific(gRingKey, ring);
+    }
+    return ring;
+}
+
+static void wakeDrainThread()
+{
+    __atomic_add_fetch(&gDrainSignal, 1, __ATOMIC_RELEASE);
+    futexWake(&gDrainSignal, 1);
+}
+
+static int asyncLogV(int prio, const char* tag, const char* fmt, va_list ap)
+{
+    LogRing* ring = ringForThread();
+    if (ring == NULL) {
+        return __android_log_vprint(prio, tag, fmt, ap);
+    }
+
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail - head >= LOG_RING_SIZE) {
+        __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    LogRecord* record = &ring->records[tail & (LOG_RING_SIZE - 1)];
+    record->prio = prio;
+    record->tag = tag;
+    int len = vsnprintf(record->text, LOG_TEXT_MAX, fmt, ap);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    // Don't wait for the next drain interval once the ring is half full.
+    if (tail + 1 - head == LOG_RING_SIZE / 2) {
+        wakeDrainThread();
+    }
+    return len;
+}
+
+// Hands every published record to logd.  gDrainLock must be held.
+static void drainRings()
+{
+    LogRing* ring = __atomic_load_n(&gRings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        uint32_t head = ring->head;
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const LogRecord* record = &ring->records[head & (LOG_RING_SIZE - 1)];
+            __android_log_write(record->prio, record->tag, record->text);
+            // Free the slot right away so a busy producer can reuse it.
+            __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        }
+        uint32_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped) {
+            __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                    "async log: ring full, %u messages dropped", dropped);
+        }
+    }
+}
+
+static void* drainThreadLoop(void*)
+{
+    prctl(PR_SET_NAME, (unsigned long) "tm:log", 0, 0, 0);
+
+    struct timespec interval;
+    interval.tv_sec = 0;
+    interval.tv_nsec = DRAIN_INTERVAL_NS;
+    while (__atomic_load_n(&gAsyncLogging, __ATOMIC_ACQUIRE)) {
+        int32_t signal = __atomic_load_n(&gDrainSignal, __ATOMIC_ACQUIRE);
+        pthread_mutex_lock(&gDrainLock);
+        drainRings();
+        pthread_mutex_unlock(&gDrainLock);
+        futexWait(&gDrainSignal, signal, &interval);
+    }
+    return NULL;
+}
+
+extern "C" int androidLogVPrint(int prio, const char* tag, const char* fmt, va_list ap)
+{
+    if (!__atomic_load_n(&gAsyncLogging, __ATOMIC_RELAXED)) {
+        return __android_log_vprint(prio, tag, fmt, ap);
+    }
+    if (prio >= ANDROID_LOG_ERROR) {
+        // Keep errors after what this thread queued before them.
+        androidFlushAsyncLog();
+        return __android_log_vprint(prio, tag, fmt, ap);
+    }
+    return asyncLogV(prio, tag, fmt, ap);
+}
+
+extern "C" int androidLogPrint(int prio, const char* tag, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int result = androidLogVPrint(prio, tag, fmt, ap);
+    va_end(ap);
+    return result;
+}
+
+extern "C" void androidSetAsyncLogging(int enable)
+{
+    pthread_mutex_lock(&gControlLock);
+    if (enable && !gDrainThreadRunning) {
+        __atomic_store_n(&gAsyncLogging, 1, __ATOMIC_RELEASE);
+        int result = pthread_create(&gDrainThread, NULL, drainThreadLoop, NULL);
+        if (result != 0) {
+            __atomic_store_n(&gAsyncLogging, 0, __ATOMIC_RELEASE);
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                    "async log: could not start drain thread, errno=%d", result);
+        } else {
+            gDrainThreadRunning = true;
+        }
+    } else if (!enable && gDrainThreadRunning) {
+        __atomic_store_n(&gAsyncLogging, 0, __ATOMIC_RELEASE);
+        wakeDrainThread();
+        pthread_join(gDrainThread, NULL);
+        gDrainThreadRunning = false;
+        // A caller that saw the flag just before it dropped may still
+        // publish after this; its record goes out with the next flush.
+        androidFlushAsyncLog();
+    }
+    pthread_mutex_unlock(&gControlLock);
+}
+
+extern "C" void androidFlushAsyncLog(void)
+{
+    pthread_mutex_lock(&gDrainLock);
+    drainRings();
+    pthread_mutex_unlock(&gDrainLock);
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Coroutine.h"
+#include "MessageQueue.h"
+#include "Mutex.h"
+#include "logging.h"
+
+namespace ThreadManager{
+
+//-------- CoroutineFramePool -------
+
+struct FreeFrame {
+	FreeFrame* next;
+};
+
+struct FrameClass {
+	Mutex lock;
+	FreeFrame* head;	// guarded by lock
+	int32_t count;		// guarded by lock
+};
+
+static FrameClass gFrameClasses[CoroutineFramePool::FRAME_CLASSES];
+
+// Size class for size, or -1 if it is too big to pool.
+static int frameClassOf(size_t size)
+{
+	size_t classSize = (size_t) 1 << CoroutineFramePool::MIN_FRAME_SHIFT;
+	for (int i = 0; i < CoroutineFramePool::FRAME_CLASSES; i++, classSize <<= 1) {
+		if (size <= classSize) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void* CoroutineFramePool::allocate(size_t size){
+	int index = frameClassOf(size);
+	if (index < 0) {
+		return malloc(size);
+	}
+	FrameClass& frameClass = gFrameClasses[index];
+	{//acquire lock
+		AutoMutex _l(frameClass.lock);
+		FreeFrame* frame = frameClass.head;
+		if (frame != NULL) {
+			frameClass.head = frame->next;
+			frameClass.count--;
+			return frame;
+		}
+	}//release lock
+	// Allocate the whole class so the frame can serve any size in it.
+	return malloc((size_t) 1 << (MIN_FRAME_SHIFT + index));
+}
+
+void CoroutineFramePool::free(void* frame, size_t size){
+	int index = frameClassOf(size);
+	if (index >= 0) {
+		FrameClass& frameClass = gFrameClasses[index];
+		AutoMutex _l(frameClass.lock);
+		if (frameClass.count < MAX_CACHED_FRAMES) {
+			FreeFrame* freeFrame = static_cast<FreeFrame*>(frame);
+			freeFrame->next = frameClass.head;
+			frameClass.head = freeFrame;
+			frameClass.count++;
+			return;
+		}
+	}
+	::free(frame);
+}
+
+//-------- LooperResumer -------
+
+bool LooperResumer::post(LooperInterface* looper, CoroutineHandle handle, nsecs_t when){
+	if (looper == NULL) {
+		mStatus = NO_INIT;
+		return false;
+	}
+	mHandle = handle;
+	Message* msg = Message::createMessage(this);
+	if (msg == NULL) {
+		mStatus = NO_MEMORY;
+		return false;
+	}
+	// From here on the looper may resume, and finish, the coroutine.
+	if (!looper->getQueue()->enqueueMessage(*msg, when)) {
+		msg->recycle();
+		mStatus = DEAD_OBJECT;
+		return false;
+	}
+	return true;
+}
+
+void LooperResumer::run(){
+	mHandle.resume();
+}
+
+//-------- Delay -------
+
+Delay::Delay(nsecs_t timeout)
+		: mLooper(Looper::getForThread())
+		, mWhen(systemTime(SYSTEM_TIME_MONOTONIC) + (timeout > 0 ? timeout : 0)){
+	if (mLooper == NULL) {
+		ALOGE("delay() needs a looper thread");
+		mStatus = NO_INIT;
+	}
+}
+
+//-------- FdReadable -------
+
+bool FdReadable::await_suspend(CoroutineHandle handle){
+	mPoll = Poll::getForThread();
+	if (mPoll == NULL) {
+		ALOGE("fdReadable() needs a looper thread");
+		mEvents = NO_INIT;
+		return false;
+	}
+	mHandle = handle;
+	if (mPoll->addFd(mFd, 0, ALOOPER_EVENT_INPUT, this, NULL) < 0) {
+		mEvents = UNKNOWN_ERROR;
+		return false;
+	}
+	return true;
+}
+
+int FdReadable::handleEvent(int fd, int events, void* /*data*/){
+	// Unregister first: the coroutine may wait on the same fd again.
+	mPoll->removeFd(fd);
+	mEvents = events;
+	mHandle.resume();
+	// Already removed; this object may be gone by now.
+	return 1;
+}
+
+}//namespace ThreadManager
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_COROUTINE_H
+#define _LIBS_COROUTINE_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define COROUTINE_NAMESPACE std
+#else
+#include <experimental/coroutine>
+#define COROUTINE_NAMESPACE std::experimental
+#endif
+
+#include "Errors.h"
+#include "Timers.h"
+#include "Looper.h"
+#include "Message.h"
+#include "Poll.h"
+
+namespace ThreadManager{
+
+typedef COROUTINE_NAMESPACE::coroutine_handle<> CoroutineHandle;
+
+/*
+ * Recycles coroutine frames by size class, so starting a coroutine does
+ * not reach malloc() once the pool is warm.  Frames may be freed on
+ * another thread than the one that allocated them.
+ */
+class CoroutineFramePool {
+public:
+	enum {
+		MIN_FRAME_SHIFT   = 7,		// smallest class: 128 bytes
+		FRAME_CLASSES     = 5,		// up to 2048 bytes; bigger frames use malloc()
+		MAX_CACHED_FRAMES = 64		// per class
+	};
+
+	static void* allocate(size_t size);
+	static void free(void* frame, size_t size);
+};
+
+/*
+ * Return type of a fire-and-forget coroutine.  It starts running on the
+ * calling thread and its frame goes away when it finishes; hand results
+ * back through a Promise.  There are no exceptions to propagate.
+ */
+class Task {
+public:
+	struct promise_type {
+		Task get_return_object(){ return Task(); }
+		static Task get_return_object_on_allocation_failure(){ return Task(); }
+		COROUTINE_NAMESPACE::suspend_never initial_suspend() noexcept { return {}; }
+		COROUTINE_NAMESPACE::suspend_never final_suspend() noexcept { return {}; }
+		void return_void(){}
+		void unhandled_exception(){ abort(); }
+
+		static void* operator new(size_t size) noexcept {
+			return CoroutineFramePool::allocate(size);
+		}
+		static void operator delete(void* frame, size_t size){
+			CoroutineFramePool::free(frame, size);
+		}
+	};
+};
+
+/*
+ * Resumes the coroutine from a message on a looper.
+ */
+class LooperResumer : public Runnable {
+public:
+	LooperResumer() : mStatus(NO_ERROR){}
+
+	bool await_ready()const{ return mStatus != NO_ERROR; }
+	status_t await_resume()const{ return mStatus; }
+
+	virtual void run();
+
+protected:
+	/**
+     * Post the resumption to looper at when (SYSTEM_TIME_MONOTONIC).
+     * Returns false, with mStatus set, if it could not be posted.
+     */
+	bool post(LooperInterface* looper, CoroutineHandle handle, nsecs_t when);
+
+	status_t mStatus;
+
+private:
+	CoroutineHandle mHandle;
+};
+
+/*
+ * co_await resumeOn(looper): continue on looper's thread.  Yields
+ * NO_ERROR, or DEAD_OBJECT if the looper took no more messages, in which
+ * case the coroutine carries on where it was.
+ */
+class ResumeOn : public LooperResumer {
+public:
+	explicit ResumeOn(LooperInterface* looper) : mLooper(looper){}
+
+	bool await_ready()const{ return Looper::getForThread() == mLooper; }
+	bool await_suspend(CoroutineHandle handle){
+		return post(mLooper, handle, systemTime(SYSTEM_TIME_MONOTONIC));
+	}
+
+private:
+	LooperInterface* mLooper;
+};
+
+/*
+ * co_await delay(ns): continue on the same looper ns from now, through
+ * the queue's timed enqueue.  Yields NO_INIT, at once, off a looper.
+ */
+class Delay : public LooperResumer {
+public:
+	explicit Delay(nsecs_t timeout);
+
+	bool await_suspend(CoroutineHandle handle){
+		return post(mLooper, handle, mWhen);
+	}
+
+private:
+	LooperInterface* mLooper;
+	nsecs_t mWhen;
+};
+
+/*
+ * co_await fdReadable(fd): continue once fd is readable, on the looper
+ * whose Poll saw it.  Yields the ALOOPER_EVENT_* bits that fired, or a
+ * negative status_t if fd could not be watched.
+ */
+class FdReadable : public PollerCallback {
+public:
+	explicit FdReadable(int fd) : mFd(fd), mPoll(NULL), mEvents(0){}
+	virtual ~FdReadable(){}
+
+	bool await_ready()const{ return false; }
+	bool await_suspend(CoroutineHandle handle);
+	int await_resume()const{ return mEvents; }
+
+	virtual int handleEvent(int fd, int events, void* data);
+
+private:
+	int mFd;
+	Poll* mPoll;
+	int mEvents;
+	CoroutineHandle mHandle;
+};
+
+inline ResumeOn resumeOn(LooperInterface* looper){
+	return ResumeOn(looper);
+}
+
+inline Delay delay(nsecs_t timeout){
+	return Delay(timeout);
+}
+
+inline FdReadable fdReadable(int fd){
+	return FdReadable(fd);
+}
+
+}//namespace ThreadManager
+
+#endif //_LIBS_COROUTINE_H
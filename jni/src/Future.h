@@ -0,0 +1,341 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_FUTURE_H
+#define _LIBS_FUTURE_H
+
+#include "Errors.h"
+#include "logging.h"
+#include "SmallFunction.h"
+#include "Looper.h"
+#include "Message.h"
+#include "MessageQueue.h"
+
+namespace ThreadManager{
+
+template <typename T> class Future;
+template <typename T> class Promise;
+template <typename T> class FutureResult;
+
+template <typename U> struct FutureFulfil;
+
+/*
+ * The outcome of a Future: a status, and the value when it is NO_ERROR.
+ * There are no exceptions, so failures travel as status_t.
+ */
+template <typename T>
+class FutureResult {
+public:
+	FutureResult() : mStatus(NOT_ENOUGH_DATA), mHasValue(false){}
+	~FutureResult(){
+		if (mHasValue) {
+			value().~T();
+		}
+	}
+
+	status_t status()const{ return mStatus; }
+	T& value(){ return *reinterpret_cast<T*>(mStorage); }
+
+	template <typename V>
+	void setValue(V&& v){
+		new (mStorage) T(std::forward<V>(v));
+		mHasValue = true;
+		mStatus = NO_ERROR;
+	}
+	void setError(status_t status){ mStatus = status; }
+
+	//Call fn with the value.
+	template <typename F>
+	auto apply(F& fn) -> decltype(fn(std::declval<T>())) {
+		return fn(std::move(value()));
+	}
+
+private:
+	status_t mStatus;
+	bool mHasValue;
+	alignas(T) unsigned char mStorage[sizeof(T)];
+};
+
+template <>
+class FutureResult<void> {
+public:
+	FutureResult() : mStatus(NOT_ENOUGH_DATA){}
+
+	status_t status()const{ return mStatus; }
+	void setValue(){ mStatus = NO_ERROR; }
+	void setError(status_t status){ mStatus = status; }
+
+	template <typename F>
+	auto apply(F& fn) -> decltype(fn()) {
+		return fn();
+	}
+
+private:
+	status_t mStatus;
+};
+
+/*
+ * State shared by a Promise and its Future.  Lock-free: the result and
+ * the continuation are each set once, and whichever of the two comes
+ * second runs the continuation, as a message on the chosen looper.
+ */
+template <typename T>
+class FutureState : public Runnable {
+public:
+	//Room for a continuation and the promise it fulfils, without the heap.
+	typedef SmallFunction<void(FutureResult<T>&), 6 * sizeof(void*)> Continuation;
+
+	FutureState() : mFlags(0), mRefs(1), mLooper(NULL){}
+
+	void acquire(){
+		__atomic_add_fetch(&mRefs, 1, __ATOMIC_RELAXED);
+	}
+
+	void release(){
+		if (__atomic_sub_fetch(&mRefs, 1, __ATOMIC_ACQ_REL) == 0) {
+			delete this;
+		}
+	}
+
+	bool isReady()const{
+		return (__atomic_load_n(&mFlags, __ATOMIC_ACQUIRE) & HAS_RESULT) != 0;
+	}
+
+	FutureResult<T>& result(){ return mResult; }
+
+	//Publish the result filled in with result().
+	void complete(){
+		if (__atomic_fetch_or(&mFlags, HAS_RESULT, __ATOMIC_ACQ_REL) & HAS_CONTINUATION) {
+			schedule();
+		}
+	}
+
+	//Takes over the caller's reference until the continuation has run.
+	void setContinuation(LooperInterface* looper, Continuation&& continuation){
+		mLooper = looper;
+		mContinuation = std::move(continuation);
+		if (__atomic_fetch_or(&mFlags, HAS_CONTINUATION, __ATOMIC_ACQ_REL) & HAS_RESULT) {
+			schedule();
+		}
+	}
+
+	virtual void run(){
+		mContinuation(mResult);
+		mContinuation.reset();
+		release();
+	}
+
+private:
+	enum {
+		HAS_RESULT       = 1<<0,
+		HAS_CONTINUATION = 1<<1
+	};
+
+	void schedule(){
+		if (mLooper == NULL) {
+			run();
+			return;
+		}
+		Message* msg = Message::createMessage(this);
+		if (msg != NULL && mLooper->getQueue()->enqueueMessage(*msg,
+				systemTime(SYSTEM_TIME_MONOTONIC))) {
+			return;
+		}
+		ALOGE("FutureState: can't post the continuation; its promise is broken");
+		if (msg != NULL) {
+			msg->recycle();
+		}
+		// Destroying the continuation breaks the promise it would fulfil.
+		mContinuation.reset();
+		release();
+	}
+
+	volatile int32_t mFlags;
+	volatile int32_t mRefs;
+	LooperInterface* mLooper;
+	FutureResult<T> mResult;
+	Continuation mContinuation;
+};
+
+/*
+ * The result of work that completes later, possibly on another thread.
+ * Move-only, and consumed by then().
+ */
+template <typename T>
+class Future {
+public:
+	Future() : mState(NULL){}
+	Future(Future&& other) noexcept : mState(other.mState){ other.mState = NULL; }
+	Future& operator = (Future&& other) noexcept {
+		if (this != &other) {
+			if (mState != NULL) {
+				mState->release();
+			}
+			mState = other.mState;
+			other.mState = NULL;
+		}
+		return *this;
+	}
+	~Future(){
+		if (mState != NULL) {
+			mState->release();
+		}
+	}
+
+	bool isValid()const{ return mState != NULL; }
+	bool isReady()const{ return mState != NULL && mState->isReady(); }
+
+	/**
+     * Run fn on looper once the result is in, and return a Future for
+     * what fn returns.  fn takes the value (nothing for Future<void>).
+     * If this future failed, fn is skipped and the status passed on.
+     * A NULL looper runs fn on whichever thread completes the promise.
+     *
+     * The continuation is kept in the shared state, so chaining allocates
+     * only the next state and the message that carries it.
+     */
+	template <typename F>
+	auto then(LooperInterface* looper, F fn)
+			-> Future<decltype(std::declval<FutureResult<T>&>().apply(fn))> {
+		typedef decltype(std::declval<FutureResult<T>&>().apply(fn)) U;
+		Promise<U> next;
+		Future<U> future = next.getFuture();
+		if (mState == NULL) {
+			next.setError(NO_INIT);
+			return future;
+		}
+		FutureState<T>* state = mState;
+		mState = NULL;
+		state->setContinuation(looper, ThenContinuation<F, U>(std::move(fn), std::move(next)));
+		return future;
+	}
+
+private:
+	friend class Promise<T>;
+
+	explicit Future(FutureState<T>* state) : mState(state){}
+
+	template <typename F, typename U>
+	struct ThenContinuation {
+		ThenContinuation(F&& fn, Promise<U>&& next)
+				: mFn(std::move(fn)), mNext(std::move(next)){}
+
+		void operator () (FutureResult<T>& result){
+			if (result.status() != NO_ERROR) {
+				mNext.setError(result.status());
+			} else {
+				FutureFulfil<U>::run(mNext, mFn, result);
+			}
+		}
+
+		F mFn;
+		Promise<U> mNext;
+	};
+
+	Future(const Future&);
+	Future& operator = (const Future&);
+
+	FutureState<T>* mState;
+};
+
+/*
+ * The producing side of a Future.  Set a value or an error once, from
+ * any thread; a promise destroyed unset fails its future with
+ * DEAD_OBJECT.
+ */
+template <typename T>
+class Promise {
+public:
+	Promise() : mState(new FutureState<T>()), mFutureTaken(false){}
+	Promise(Promise&& other) noexcept
+			: mState(other.mState), mFutureTaken(other.mFutureTaken){
+		other.mState = NULL;
+	}
+	~Promise(){
+		if (mState != NULL) {
+			setError(DEAD_OBJECT);
+		}
+	}
+
+	/**
+     * The future for this promise.  Only one may be taken.
+     */
+	Future<T> getFuture(){
+		if (mState == NULL || mFutureTaken) {
+			return Future<T>();
+		}
+		mFutureTaken = true;
+		mState->acquire();
+		return Future<T>(mState);
+	}
+
+	template <typename V>
+	void setValue(V&& v){
+		if (mState != NULL) {
+			mState->result().setValue(std::forward<V>(v));
+			finish();
+		}
+	}
+
+	//For Promise<void>.
+	void setValue(){
+		if (mState != NULL) {
+			mState->result().setValue();
+			finish();
+		}
+	}
+
+	void setError(status_t status){
+		if (mState != NULL) {
+			mState->result().setError(status);
+			finish();
+		}
+	}
+
+private:
+	void finish(){
+		FutureState<T>* state = mState;
+		mState = NULL;
+		state->complete();
+		state->release();
+	}
+
+	Promise(const Promise&);
+	Promise& operator = (const Promise&);
+	Promise& operator = (Promise&&);
+
+	FutureState<T>* mState;
+	bool mFutureTaken;
+};
+
+//Fulfil next with what fn returns for result.
+template <typename U>
+struct FutureFulfil {
+	template <typename F, typename T>
+	static void run(Promise<U>& next, F& fn, FutureResult<T>& result){
+		next.setValue(result.apply(fn));
+	}
+};
+
+template <>
+struct FutureFulfil<void> {
+	template <typename F, typename T>
+	static void run(Promise<void>& next, F& fn, FutureResult<T>& result){
+		result.apply(fn);
+		next.setValue();
+	}
+};
+
+}//namespace ThreadManager
+
+#endif //_LIBS_FUTURE_H
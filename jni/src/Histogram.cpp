@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Histogram.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+namespace ThreadManager {
+
+nsecs_t Histogram::lowestValueOf(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = (bucket >> SUB_BUCKET_BITS) - 1;
+    return (nsecs_t) (SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << shift;
+}
+
+void Histogram::reset() {
+    mCount = 0;
+    mTotal = 0;
+    mMin = 0;
+    mMax = 0;
+    memset((void*) mBuckets, 0, sizeof(mBuckets));
+}
+
+void Histogram::merge(const Histogram& other) {
+    uint64_t count = other.count();
+    if (count == 0) {
+        return;
+    }
+    for (int i = 0; i < BUCKETS; i++) {
+        uint32_t n = __atomic_load_n(&other.mBuckets[i], __ATOMIC_RELAXED);
+        if (n) {
+            __atomic_store_n(&mBuckets[i], mBuckets[i] + n, __ATOMIC_RELAXED);
+        }
+    }
+    nsecs_t otherMin = other.min();
+    if (mCount == 0 || otherMin < mMin) {
+        __atomic_store_n(&mMin, otherMin, __ATOMIC_RELAXED);
+    }
+    if (other.max() > mMax) {
+        __atomic_store_n(&mMax, other.max(), __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&mTotal, mTotal + __atomic_load_n(&other.mTotal, __ATOMIC_RELAXED),
+            __ATOMIC_RELAXED);
+    __atomic_store_n(&mCount, mCount + count, __ATOMIC_RELAXED);
+}
+
+nsecs_t Histogram::mean() const {
+    uint64_t n = count();
+    return n ? __atomic_load_n(&mTotal, __ATOMIC_RELAXED) / (nsecs_t) n : 0;
+}
+
+nsecs_t Histogram::percentile(double p) const {
+    uint64_t n = count();
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t wanted = (uint64_t) (p / 100.0 * n + 0.5);
+    if (wanted < 1) {
+        wanted = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += __atomic_load_n(&mBuckets[i], __ATOMIC_RELAXED);
+        if (seen >= wanted) {
+            nsecs_t upper = i + 1 < BUCKETS ? lowestValueOf(i + 1) - 1 : max();
+            return upper < max() ? upper : max();
+        }
+    }
+    return max();
+}
+
+void Histogram::dump(int fd, const char* label) const {
+    static const double PERCENTILES[] = { 50, 90, 99, 99.9 };
+    char mean[32], max[32];
+    formatDuration(mean, sizeof(mean), this->mean());
+    formatDuration(max, sizeof(max), this->max());
+    dprintf(fd, "%s: %" PRIu64 " samples, mean %s", label, count(), mean);
+    for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); i++) {
+        char value[32];
+        formatDuration(value, sizeof(value), percentile(PERCENTILES[i]));
+        dprintf(fd, ", p%g %s", PERCENTILES[i], value);
+    }
+    dprintf(fd, ", max %s\n", max);
+}
+
+}; // namespace ThreadManager
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "JNIBindings.h"
+#include "Mutex.h"
+#include "logging.h"
+
+namespace ThreadManager{
+
+// Bindings are only added to the list; gBindingsLock guards the list and
+// resolution, lookups through a resolved binding need no lock.
+static Mutex gBindingsLock;
+static JNIClassBinding* gBindings = NULL;
+
+static bool clearException(JNIEnv* env, const char* what, const char* name)
+{
+	if (!env->ExceptionCheck()) {
+		return false;
+	}
+	ALOGE("JNIBindings: exception while looking up %s %s", what, name);
+	env->ExceptionDescribe();
+	env->ExceptionClear();
+	return true;
+}
+
+void JNIBindings::add(JNIClassBinding* binding){
+	AutoMutex _l(gBindingsLock);
+	binding->next = gBindings;
+	gBindings = binding;
+}
+
+static status_t resolveLocked(JNIEnv* env, JNIClassBinding* binding)
+{
+	if (binding->clazz == NULL) {
+		jclass local = env->FindClass(binding->className);
+		if (local == NULL) {
+			clearException(env, "class", binding->className);
+			ALOGE("JNIBindings: class %s not found", binding->className);
+			return NAME_NOT_FOUND;
+		}
+		binding->clazz = (jclass) env->NewGlobalRef(local);
+		env->DeleteLocalRef(local);
+	}
+
+	status_t result = NO_ERROR;
+	for (size_t i = 0; i < binding->methodCount; i++) {
+		JNIMethodBinding& method = binding->methods[i];
+		if (method.id != NULL) {
+			continue;
+		}
+		method.id = method.isStatic
+				? env->GetStaticMethodID(binding->clazz, method.name, method.signature)
+				: env->GetMethodID(binding->clazz, method.name, method.signature);
+		if (method.id == NULL) {
+			clearException(env, "method", method.name);
+			ALOGE("JNIBindings: method %s.%s%s not found",
+					binding->className, method.name, method.signature);
+			result = NAME_NOT_FOUND;
+		}
+	}
+	return result;
+}
+
+status_t JNIBindings::resolve(JNIEnv* env, JNIClassBinding* binding){
+	AutoMutex _l(gBindingsLock);
+	return resolveLocked(env, binding);
+}
+
+status_t JNIBindings::resolveAll(JNIEnv* env){
+	AutoMutex _l(gBindingsLock);
+	status_t result = NO_ERROR;
+	for (JNIClassBinding* binding = gBindings; binding != NULL; binding = binding->next) {
+		status_t err = resolveLocked(env, binding);
+		if (err != NO_ERROR && result == NO_ERROR) {
+			result = err;
+		}
+	}
+	return result;
+}
+
+void JNIBindings::releaseAll(JNIEnv* env){
+	AutoMutex _l(gBindingsLock);
+	for (JNIClassBinding* binding = gBindings; binding != NULL; binding = binding->next) {
+		if (binding->clazz != NULL) {
+			env->DeleteGlobalRef(binding->clazz);
+			binding->clazz = NULL;
+		}
+		for (size_t i = 0; i < binding->methodCount; i++) {
+			binding->methods[i].id = NULL;
+		}
+	}
+}
+
+status_t JNIBindings::registerNatives(JNIEnv* env, const char* className,
+		const JNINativeMethod* methods, size_t count, bool optional){
+	jclass clazz = env->FindClass(className);
+	if (clazz == NULL) {
+		clearException(env, "class", className);
+		ALOGE("JNIBindings: class %s not found", className);
+		return NAME_NOT_FOUND;
+	}
+	status_t result = NO_ERROR;
+	if (env->RegisterNatives(clazz, methods, (jint) count) != JNI_OK) {
+		if (optional) {
+			env->ExceptionClear();
+			ALOGV("JNIBindings: optional natives not declared by %s", className);
+		} else {
+			clearException(env, "natives of", className);
+			ALOGE("JNIBindings: RegisterNatives failed for %s", className);
+		}
+		result = UNKNOWN_ERROR;
+	}
+	env->DeleteLocalRef(clazz);
+	return result;
+}
+
+}//namespace ThreadManager
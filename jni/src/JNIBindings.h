@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBS_JNIBINDINGS_H
+#define _LIBS_JNIBINDINGS_H
+
+#include <stddef.h>
+#include <jni.h>
+
+#include "Errors.h"
+
+namespace ThreadManager{
+
+/*
+ * A Java method looked up once and kept.
+ */
+struct JNIMethodBinding {
+	const char* name;
+	const char* signature;
+	bool isStatic;
+	jmethodID id;		// NULL until resolved
+};
+
+/*
+ * A Java class and the methods native code calls on it.  The class is kept
+ * as a global reference, so the binding can be used from any thread,
+ * including native threads whose class loader could not find the class.
+ */
+struct JNIClassBinding {
+	const char* className;		// e.g. "com/nan/thread/Inform"
+	JNIMethodBinding* methods;
+	size_t methodCount;
+	jclass clazz;				// NULL until resolved
+	JNIClassBinding* next;		// registry link
+};
+
+/*
+ * Registry of class bindings, resolved once from JNI_OnLoad.
+ *
+ * FindClass() and GetMethodID() are slow and FindClass() only sees the
+ * application classes from a thread the VM started, so callbacks declare
+ * what they need up front and read the cached IDs on every call.
+ */
+class JNIBindings {
+public:
+	/**
+     * Add binding to the registry; resolveAll() looks it up.  Call before
+     * JNI_OnLoad, or resolve the binding yourself afterwards.
+     */
+	static void add(JNIClassBinding* binding);
+
+	/**
+     * Look up the class and methods of binding.  Any exception raised on
+     * the way is logged and cleared.
+     *
+     * Returns NO_ERROR, or NAME_NOT_FOUND if the class or a method is missing.
+     */
+	static status_t resolve(JNIEnv* env, JNIClassBinding* binding);
+
+	/**
+     * Resolve every registered binding not resolved yet.
+     *
+     * Returns NO_ERROR, or the first failure; the other bindings are still
+     * resolved.
+     */
+	static status_t resolveAll(JNIEnv* env);
+
+	/**
+     * Drop the global references of every registered binding.
+     */
+	static void releaseAll(JNIEnv* env);
+
+	/**
+     * RegisterNatives() on className.  Any exception raised is logged and
+     * cleared.  With optional set, methods the class does not declare are
+     * expected: the failure is cleared without logging an error.
+     *
+     * Returns NO_ERROR, NAME_NOT_FOUND if the class is missing, or
+     * UNKNOWN_ERROR if a method could not be bound.
+     */
+	static status_t registerNatives(JNIEnv* env, const char* className,
+			const JNINativeMethod* methods, size_t count, bool optional = false);
+};
+
+}//namespace ThreadManager
+
+#endif //_LIBS_JNIBINDINGS_H
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "JNIEnvCache.h"
+#include "logging.h"
+
+#include <pthread.h>
+#include <sys/prctl.h>
+
+namespace ThreadManager{
+
+static JavaVM* volatile gJavaVM = NULL;
+
+// Set only on threads getEnv() attached; its destructor detaches them.
+static pthread_key_t gAttachedEnvKey;
+static pthread_once_t gAttachedEnvKeyOnce = PTHREAD_ONCE_INIT;
+
+static void detachThread(void* /*env*/)
+{
+	JavaVM* vm = __atomic_load_n(&gJavaVM, __ATOMIC_ACQUIRE);
+	if (vm != NULL && vm->DetachCurrentThread() != JNI_OK) {
+		ALOGE("%s: DetachCurrentThread() failed", __FUNCTION__);
+	}
+}
+
+static void initAttachedEnvKey()
+{
+	pthread_key_create(&gAttachedEnvKey, detachThread);
+}
+
+void JNIEnvCache::setJavaVM(JavaVM* vm){
+	__atomic_store_n(&gJavaVM, vm, __ATOMIC_RELEASE);
+}
+
+JavaVM* JNIEnvCache::getJavaVM(){
+	return __atomic_load_n(&gJavaVM, __ATOMIC_ACQUIRE);
+}
+
+JNIEnv* JNIEnvCache::getEnv(){
+	pthread_once(&gAttachedEnvKeyOnce, initAttachedEnvKey);
+	JNIEnv* env = (JNIEnv*) pthread_getspecific(gAttachedEnvKey);
+	if (env != NULL) {
+		return env;
+	}
+
+	JavaVM* vm = getJavaVM();
+	if (vm == NULL) {
+		ALOGE("%s: no JavaVM; JNI_OnLoad has not run", __FUNCTION__);
+		return NULL;
+	}
+	if (vm->GetEnv((void**) &env, JNI_VERSION_1_6) == JNI_OK) {
+		// A thread the VM knows already; it is not ours to detach.
+		return env;
+	}
+
+	// Attach under the thread's own name so it shows up properly in Java.
+	char name[16] = { 0 };
+	prctl(PR_GET_NAME, name, 0, 0, 0);
+	JavaVMAttachArgs args;
+	args.version = JNI_VERSION_1_6;
+	args.name = name;
+	args.group = NULL;
+	if (vm->AttachCurrentThread(&env, &args) != JNI_OK) {
+		ALOGE("%s: AttachCurrentThread() failed", __FUNCTION__);
+		return NULL;
+	}
+	pthread_setspecific(gAttachedEnvKey, env);
+	return env;
+}
+
+void JNIEnvCache::detach(){
+	pthread_once(&gAttachedEnvKeyOnce, initAttachedEnvKey);
+	void* env = pthread_getspecific(gAttachedEnvKey);
+	if (env != NULL) {
+		pthread_setspecific(gAttachedEnvKey, NULL);
+		detachThread(env);
+	}
+}
+
+}//namespace ThreadManager
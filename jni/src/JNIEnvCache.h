@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBS_JNIENVCACHE_H
+#define _LIBS_JNIENVCACHE_H
+
+#include <jni.h>
+
+namespace ThreadManager{
+
+/*
+ * The JNIEnv of the calling thread.
+ *
+ * A native thread is attached to the VM the first time it asks for its env
+ * and stays attached until it exits, when a thread-specific destructor
+ * detaches it.  Threads the VM started itself are never attached or
+ * detached here.  A JNIEnv must not leave its thread, so always ask this
+ * class rather than keep one in an object.
+ */
+class JNIEnvCache {
+public:
+	/**
+     * Set the VM; call from JNI_OnLoad.
+     */
+	static void setJavaVM(JavaVM* vm);
+
+	static JavaVM* getJavaVM();
+
+	/**
+     * Returns the env of the calling thread, attaching it if needed, or
+     * NULL if there is no VM or the attach failed.
+     */
+	static JNIEnv* getEnv();
+
+	/**
+     * Detach the calling thread now, if it was attached by getEnv().
+     */
+	static void detach();
+};
+
+}//namespace ThreadManager
+
+#endif //_LIBS_JNIENVCACHE_H
@@ -5,35 +5,142 @@
 #include "Message.h"
 #include "MessageQueue.h"
 #include "ThreadDefs.h"
+#include "JNIBindings.h"
+#include "JNIEnvCache.h"
 #include <jni.h>
+#include <string.h>
 
 namespace ThreadManager{
 
 static jobject g_obj = NULL;
-static JavaVM *g_jvm = NULL;
 
 int flag = 1;
 
+//----------- Java bindings, resolved in JNI_OnLoad --------------
+enum {
+	INFORM_INIT,
+	INFORM_PRINT_STRING,
+	INFORM_PRINT_STRINGS,
+	INFORM_ON_BUFFER,
+	INFORM_HANDLE_MESSAGE,
+};
+
+static JNIMethodBinding gInformMethods[] = {
+	{ "<init>",        "()V",                         false, NULL },
+	{ "printString",   "()V",                         false, NULL },
+	{ "printStrings",  "(Ljava/nio/ByteBuffer;I)V",   false, NULL },
+	{ "onBuffer",      "(Ljava/nio/ByteBuffer;III)V", false, NULL },
+	{ "handleMessage", "(III)V",                      false, NULL },
+};
+
+static JNIClassBinding gInformClass = {
+	"com/nan/thread/Inform", gInformMethods,
+	sizeof(gInformMethods) / sizeof(gInformMethods[0]), NULL, NULL
+};
+
+enum {
+	CFORCALL_INIT,
+	CFORCALL_GET_JAVA_STRING,
+};
+
+static JNIMethodBinding gCForCallMethods[] = {
+	{ "<init>",        "()V",                  false, NULL },
+	{ "GetJavaString", "()Ljava/lang/String;", false, NULL },
+};
+
+static JNIClassBinding gCForCallClass = {
+	"com/nan/thread/CForCall", gCForCallMethods,
+	sizeof(gCForCallMethods) / sizeof(gCForCallMethods[0]), NULL, NULL
+};
+
 //----------- NativeTManager --------------
+
+/*
+ * One notification in a batch handed to Inform.printStrings(ByteBuffer, int).
+ * The buffer is in native byte order and only valid during the call.
+ */
+struct NotifyRecord {
+	int64_t when;		// Message::getWhen(), SYSTEM_TIME_MONOTONIC ns
+	int32_t what;
+	int32_t arg1;
+	int32_t arg2;
+	int32_t reserved;
+};
+
+/*
+ * Pins a Java direct ByteBuffer while native code uses its memory.
+ */
+class DirectBufferToken : public PayloadToken {
+public:
+	explicit DirectBufferToken(jobject buffer) : mBuffer(buffer) {}
+
+	virtual void release() {
+		JNIEnv* env = JNIEnvCache::getEnv();
+		if (env != NULL) {
+			env->DeleteGlobalRef(mBuffer);
+		}
+		delete this;
+	}
+
+private:
+	jobject mBuffer;	// global ref
+};
+
 class NativeTManager : public MessageHandlerPolicyInterface 
-					, public LooperPolicyInterface {
+					, public LooperPolicyInterface
+					, public MessageQueueInterface::IdleHandler {
 protected:
 	virtual ~NativeTManager();
 public:
-	NativeTManager(jobject serviceObj);
+	NativeTManager(jobject serviceObj, const char* name = "Anthor Thread");
 	virtual void start();
 	virtual int sendMsg();
+
+	//Send data without copying it; token is released after dispatch.
+	int sendBuffer(void* data, size_t size, PayloadToken* token);
+
+	//Send what/arg1/arg2 and an optional payload, delayMillis from now.
+	int sendMessage(int32_t what, int32_t arg1, int32_t arg2,
+			void* data, size_t size, PayloadToken* token, int64_t delayMillis);
+
+	//Drop the queued messages with the given what.
+	void removeMessages(int32_t what);
+
+	const char* getName() const { return mName; }
 	virtual void attachJavaThread();
 	virtual void detachJavaThread();
-	virtual void notifyMessage();
+	virtual void notifyMessage(const Message* msg);
+	virtual bool queueIdle();
+
+	//Deliver notifications to Java in batches instead of one call each.
+	void setBatching(bool enable);
 private:
+	//Hand the pending notifications to Java.  Looper thread only.
+	void flushBatch(JNIEnv* env);
+
+	//Hand a message payload to Java as a direct ByteBuffer.
+	void notifyBuffer(JNIEnv* env, const Message* msg);
+
+	enum {
+		BATCH_RECORDS = 64
+	};
+
+	char mName[32];
 	jobject mServiceObj;
 	HandleThread* ht;
-	JNIEnv* mEnv;
 	MessageHandlerInterface* mh;
+
+	volatile int32_t mBatching;
+	NotifyRecord mBatch[BATCH_RECORDS];
+	size_t mBatchCount;
+	//Direct ByteBuffer over mBatch, made on first flush.
+	jobject mBatchBuffer;
 };//end of class NativeTManager
 
-NativeTManager::NativeTManager(jobject serviceObj){
+NativeTManager::NativeTManager(jobject serviceObj, const char* name)
+		: mh(NULL), mBatching(0), mBatchCount(0), mBatchBuffer(NULL){
+	strncpy(mName, name, sizeof(mName) - 1);
+	mName[sizeof(mName) - 1] = '\0';
 	mServiceObj = serviceObj;
 	ht = new HandleThread(this);
 	LOG_IF_ERRNO(NULL == ht,"Can't allocate a new MessageHandler.");
@@ -41,35 +148,131 @@ NativeTManager::NativeTManager(jobject serviceObj){
 
 NativeTManager::~NativeTManager(){
 	delete ht;
-	mEnv->DeleteGlobalRef(mServiceObj);
+	JNIEnv* env = JNIEnvCache::getEnv();
+	if (env == NULL) {
+		return;
+	}
+	if (mBatchBuffer != NULL) {
+		env->DeleteGlobalRef(mBatchBuffer);
+	}
+	env->DeleteGlobalRef(mServiceObj);
 }
 
 void NativeTManager::start(){
-	int result = ht->run("Anthor Thread", PRIORITY_URGENT_DISPLAY);
-	LOG_IF_ERRNO(result!=0,"Could not start Anthor thread due to error %d.", result);
+	int result = ht->run(mName, PRIORITY_URGENT_DISPLAY);
+	LOG_IF_ERRNO(result!=0,"Could not start %s thread due to error %d.", mName, result);
 
 	mh = new MessageHandler(ht->getLooper(),ht->getLooper()->getQueue(),this);
 	LOG_IF_ERRNO(NULL == mh,"Can't allocate a new MessageHandler.");
+
+	//Flush batched notifications whenever the looper runs dry.
+	ht->getLooper()->getQueue()->addIdleHandler(this);
+}
+
+void NativeTManager::setBatching(bool enable){
+	__atomic_store_n(&mBatching, enable ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+bool NativeTManager::queueIdle(){
+	if (mBatchCount != 0) {
+		JNIEnv* env = JNIEnvCache::getEnv();
+		if (env != NULL) {
+			flushBatch(env);
+		}
+	}
+	return true;
+}
+
+void NativeTManager::flushBatch(JNIEnv* env){
+	if (mBatchCount == 0) {
+		return;
+	}
+	if (mBatchBuffer == NULL) {
+		jobject buffer = env->NewDirectByteBuffer(mBatch, sizeof(mBatch));
+		if (buffer == NULL) {
+			env->ExceptionClear();
+			ALOGE("Can't wrap the notification batch, dropping %zu.", mBatchCount);
+			mBatchCount = 0;
+			return;
+		}
+		mBatchBuffer = env->NewGlobalRef(buffer);
+		env->DeleteLocalRef(buffer);
+	}
+
+	env->CallVoidMethod(g_obj, gInformMethods[INFORM_PRINT_STRINGS].id,
+			mBatchBuffer, (jint) mBatchCount);
+	mBatchCount = 0;
 }
 
 int NativeTManager::sendMsg(){
-	mh->sendMessage(*(mh->obtainMessage()),systemTime(SYSTEM_TIME_MONOTONIC));
+	Message* msg = mh->obtainMessage();
+	if (msg == NULL) {
+		return NO_MEMORY;
+	}
+	return mh->sendMessage(*msg, systemTime(SYSTEM_TIME_MONOTONIC)) ? NO_ERROR : UNKNOWN_ERROR;
+}
+
+int NativeTManager::sendBuffer(void* data, size_t size, PayloadToken* token){
+	return sendMessage(0, 0, 0, data, size, token, 0);
+}
+
+int NativeTManager::sendMessage(int32_t what, int32_t arg1, int32_t arg2,
+		void* data, size_t size, PayloadToken* token, int64_t delayMillis){
+	Message* msg = mh->obtainMessage(what, arg1, arg2);
+	if (msg == NULL) {
+		if (token != NULL) {
+			token->release();
+		}
+		return NO_MEMORY;
+	}
+	if (data != NULL || token != NULL) {
+		msg->setPayload(data, size, token);
+	}
+	bool sent = delayMillis > 0 ? mh->sendMessageDelayed(*msg, delayMillis)
+			: mh->sendMessage(*msg, systemTime(SYSTEM_TIME_MONOTONIC));
+	if (!sent) {
+		msg->recycle();
+		return UNKNOWN_ERROR;
+	}
+	return NO_ERROR;
+}
+
+void NativeTManager::removeMessages(int32_t what){
+	mh->removeMessages(what);
+}
+
+void NativeTManager::notifyBuffer(JNIEnv* env, const Message* msg){
+	jmethodID mid = gInformMethods[INFORM_ON_BUFFER].id;
+	if (mid == NULL) {
+		ALOGE("Inform.onBuffer() is not bound.");
+		return;
+	}
+	// No copy: Java sees the payload memory itself, valid for this call only.
+	jobject buffer = env->NewDirectByteBuffer(msg->getData(), (jlong) msg->getDataSize());
+	if (buffer == NULL) {
+		env->ExceptionClear();
+		ALOGE("Can't wrap a %zu byte payload.", msg->getDataSize());
+		return;
+	}
+	env->CallVoidMethod(g_obj, mid, buffer, (jint) msg->getWhat(),
+			(jint) msg->getArg1(), (jint) msg->getArg2());
+	env->DeleteLocalRef(buffer);
 }
 
 void NativeTManager::attachJavaThread(){
-	LOG_IF_ERRNO(g_jvm->AttachCurrentThread(&mEnv, NULL) != JNI_OK
+	// Attaches on the first call only; the thread detaches when it exits.
+	LOG_IF_ERRNO(JNIEnvCache::getEnv() == NULL
 		, "%s: AttachCurrentThread() failed", __FUNCTION__);    
 }
 
 void NativeTManager::detachJavaThread(){
-	LOG_IF_ERRNO(g_jvm->DetachCurrentThread() != JNI_OK 
-		, "%s: DetachCurrentThread() failed", __FUNCTION__);
+	JNIEnvCache::detach();
 }
 
-jobject getInstance(JNIEnv* env, jclass obj_class){    
-	jmethodID construction_id = env->GetMethodID(obj_class, "<init>", "()V"); 
+jobject getInstance(JNIEnv* env, const JNIClassBinding& binding, int constructor){    
+	jmethodID construction_id = binding.methods[constructor].id; 
 	LOG_IF_ERRNO(construction_id == NULL,"Get Method error.");
-	jobject obj = env->NewObject(obj_class, construction_id);  
+	jobject obj = env->NewObject(binding.clazz, construction_id);  
 	LOG_IF_ERRNO(obj == NULL,"Get New Object error.");
 	return obj;
 }
@@ -77,17 +280,16 @@ jobject getInstance(JNIEnv* env, jclass obj_class){
 
 jstring get(JNIEnv* env){
 	jstring str;  
-	jclass java_class = env->FindClass("com/nan/thread/CForCall");    
-	if (java_class == 0){       
+	if (gCForCallClass.clazz == NULL || gCForCallMethods[CFORCALL_INIT].id == NULL){       
 		return env->NewStringUTF("not find class!");    
 	}   
 
-	jobject java_obj = getInstance(env, java_class);   
+	jobject java_obj = getInstance(env, gCForCallClass, CFORCALL_INIT);   
 	if (java_obj == 0){       
 		return env->NewStringUTF("not find java OBJ!");   
 	}   
 
-	jmethodID java_method = env->GetMethodID(java_class, "GetJavaString", "()Ljava/lang/String;");  
+	jmethodID java_method = gCForCallMethods[CFORCALL_GET_JAVA_STRING].id;  
 
 	if(java_method == 0){       
 		return env->NewStringUTF("not find java method!");   
@@ -95,30 +297,60 @@ jstring get(JNIEnv* env){
 	}   
 
 	str = (jstring)env->CallObjectMethod(java_obj, java_method);   
+	env->DeleteLocalRef(java_obj);
 	return str;
 }
 
 
-void NativeTManager::notifyMessage(){
+void NativeTManager::notifyMessage(const Message* msg){
 
-	if(mEnv == NULL){
+	JNIEnv* env = JNIEnvCache::getEnv();
+	if(env == NULL){
 		ALOGE("Get the JNI ENV ERROR.");
 		return;
 	}
-	
-	jclass cls = mEnv->GetObjectClass(g_obj);
-
-	LOG_IF_ERRNO(cls == NULL,"Get class error.");
 
-	jmethodID mid = mEnv->GetMethodID(cls,"printString","()V");
+	if (msg->getData() != NULL && msg->getDataSize() != 0) {
+		//Payloads go up on their own: the memory is only ours until recycle.
+		flushBatch(env);
+		notifyBuffer(env, msg);
+		return;
+	}
 
-	LOG_IF_ERRNO(mid == NULL,"Get method error.");
+	if (__atomic_load_n(&mBatching, __ATOMIC_RELAXED)
+			&& gInformMethods[INFORM_PRINT_STRINGS].id != NULL) {
+		NotifyRecord& record = mBatch[mBatchCount++];
+		record.when = msg->getWhen();
+		record.what = msg->getWhat();
+		record.arg1 = msg->getArg1();
+		record.arg2 = msg->getArg2();
+		record.reserved = 0;
+		if (mBatchCount == BATCH_RECORDS) {
+			flushBatch(env);
+		}
+		return;
+	}
+	//Batching was just turned off; keep the notifications in order.
+	flushBatch(env);
+	
+	// Resolved once in JNI_OnLoad; no class or method lookup per message.
+	jmethodID mid = gInformMethods[INFORM_HANDLE_MESSAGE].id;
+	if (mid != NULL) {
+		env->CallVoidMethod(g_obj, mid, (jint) msg->getWhat(),
+				(jint) msg->getArg1(), (jint) msg->getArg2());
+		return;
+	}
+	mid = gInformMethods[INFORM_PRINT_STRING].id;
+	if (mid == NULL) {
+		ALOGE("Inform.printString() is not bound.");
+		return;
+	}
 
-	mEnv->CallVoidMethod(g_obj,mid);
+	env->CallVoidMethod(g_obj,mid);
 
 	/*
 	//Get the method from the class.
-	mid = mEnv->GetStaticMethodID(cls, "fromJNI", "(I)V");
+	mid = env->GetStaticMethodID(cls, "fromJNI", "(I)V");
 	if (mid == NULL) 
 	{
 		ALOGE("GetMethodID() Error.....");
@@ -126,72 +358,205 @@ void NativeTManager::notifyMessage(){
 	}
 
 	//Invoke static method.
-	mEnv->CallStaticVoidMethod(cls, mid ,flag++);
+	env->CallStaticVoidMethod(cls, mid ,flag++);
 	*/
 }
 
 //-------------- Native method. --------------------
 
-void initClassHelper(JNIEnv *env, const char *path, jobject *objptr) {
-    jclass cls = env->FindClass(path);
-    if(!cls) {
-        ALOGE("initClassHelper: failed to get %s class reference", path);
+void initClassHelper(JNIEnv *env, JNIClassBinding *binding, int constructor, jobject *objptr) {
+    if(JNIBindings::resolve(env, binding) != NO_ERROR && !binding->clazz) {
+        ALOGE("initClassHelper: failed to get %s class reference", binding->className);
         return;
     }
-    jmethodID constr = env->GetMethodID(cls, "<init>", "()V");
+    jmethodID constr = binding->methods[constructor].id;
     if(!constr) {
-        ALOGE("initClassHelper: failed to get %s constructor", path);
+        ALOGE("initClassHelper: failed to get %s constructor", binding->className);
         return;
     }
-    jobject obj = env->NewObject(cls, constr);
+    jobject obj = env->NewObject(binding->clazz, constr);
     if(!obj) {
-        ALOGE("initClassHelper: failed to create a %s object", path);
+        ALOGE("initClassHelper: failed to create a %s object", binding->className);
         return;
     }
     (*objptr) = env->NewGlobalRef(obj);
+    env->DeleteLocalRef(obj);
 }
 
 
 
-extern "C"{
-	JNIEXPORT int Java_com_nan_thread_MyThreadActivity_nativeStart( JNIEnv* env, jobject obj, jint ptr);
-	JNIEXPORT int Java_com_nan_thread_MyThreadActivity_nativeSendMsg( JNIEnv* env, jobject obj, jint ptr);
-	JNIEXPORT int Java_com_nan_thread_MyThreadActivity_nativeInit( JNIEnv* env, jobject obj);
-	JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved);
-	JNIEXPORT jstring JNICALL Java_com_nan_thread_MyThreadActivity_stringFromJNI(JNIEnv* env, jobject thiz);
+//Handles are jlong so they hold a pointer on 64-bit.
+static inline NativeTManager* fromHandle(jlong handle){
+	return reinterpret_cast<NativeTManager*>(static_cast<intptr_t>(handle));
 }
 
-
-extern "C" JNIEXPORT jstring JNICALL Java_com_nan_thread_MyThreadActivity_stringFromJNI(JNIEnv* env, jobject thiz){ 
+static jstring nativeStringFromJNI(JNIEnv* env, jobject thiz){ 
 	return get(env);
 }
 
+static jint nativeStart(JNIEnv* env, jobject obj, jlong ptr)
+{
+	fromHandle(ptr)->start();
+	return NO_ERROR;
+}
 
-//
-extern "C" JNIEXPORT int Java_com_nan_thread_MyThreadActivity_nativeStart( JNIEnv* env, jobject obj, jint ptr)
+/*
+ * The send path touches no Java state, so it is registered for
+ * @FastNative instance methods and, without env or object, for
+ * @CriticalNative static ones.
+ */
+static jint nativeSendMsg(JNIEnv* env, jobject obj, jlong ptr)
 {
-    NativeTManager* im = reinterpret_cast<NativeTManager*>(ptr);
-	im->start();
+	return fromHandle(ptr)->sendMsg();
 }
 
-//
-extern "C" JNIEXPORT int Java_com_nan_thread_MyThreadActivity_nativeSendMsg( JNIEnv* env, jobject obj, jint ptr)
+static jint nativeSendMsgCritical(jlong ptr)
+{
+	return fromHandle(ptr)->sendMsg();
+}
+
+/*
+ * Check a direct ByteBuffer range and pin the buffer for the message.
+ * The global ref keeps the buffer, and so its memory, alive until dispatch.
+ */
+static status_t pinBuffer(JNIEnv* env, jobject buffer, jint offset, jint length,
+		void** data, PayloadToken** token)
+{
+	uint8_t* base = (uint8_t*) env->GetDirectBufferAddress(buffer);
+	jlong capacity = env->GetDirectBufferCapacity(buffer);
+	if (base == NULL || offset < 0 || length < 0 || (jlong) offset + length > capacity) {
+		ALOGE("pinBuffer: need a direct ByteBuffer with %d bytes at %d", length, offset);
+		return BAD_VALUE;
+	}
+	jobject pinned = env->NewGlobalRef(buffer);
+	if (pinned == NULL) {
+		return NO_MEMORY;
+	}
+	*data = base + offset;
+	*token = new DirectBufferToken(pinned);
+	return NO_ERROR;
+}
+
+static jint nativeSendBuffer(JNIEnv* env, jobject obj, jlong ptr, jobject buffer, jint offset, jint length)
+{
+	void* data = NULL;
+	PayloadToken* token = NULL;
+	status_t result = pinBuffer(env, buffer, offset, length, &data, &token);
+	if (result != NO_ERROR) {
+		return result;
+	}
+	return fromHandle(ptr)->sendBuffer(data, (size_t) length, token);
+}
+
+/*
+ * Java-side Handler.sendMessageDelayed(): what, arg1 and arg2 travel in
+ * the Message itself, so no local refs are made unless there is a buffer.
+ */
+static jint nativeSendMessage(JNIEnv* env, jobject obj, jlong ptr, jint what, jint arg1, jint arg2,
+		jobject buffer, jint offset, jint length, jlong delayMillis)
+{
+	void* data = NULL;
+	PayloadToken* token = NULL;
+	if (buffer != NULL) {
+		status_t result = pinBuffer(env, buffer, offset, length, &data, &token);
+		if (result != NO_ERROR) {
+			return result;
+		}
+	} else {
+		length = 0;
+	}
+	return fromHandle(ptr)->sendMessage(what, arg1, arg2, data, (size_t) length, token, delayMillis);
+}
+
+static void nativeRemoveMessages(JNIEnv* env, jobject obj, jlong ptr, jint what)
 {
-    NativeTManager* im = reinterpret_cast<NativeTManager*>(ptr);
-	return im->sendMsg();
+	fromHandle(ptr)->removeMessages(what);
 }
 
+static void nativeSetBatching(JNIEnv* env, jobject obj, jlong ptr, jboolean enable)
+{
+	fromHandle(ptr)->setBatching(enable == JNI_TRUE);
+}
 
-extern "C" JNIEXPORT int Java_com_nan_thread_MyThreadActivity_nativeInit( JNIEnv* env, jobject obj)
+static jlong nativeInit(JNIEnv* env, jobject obj)
 {
-	initClassHelper(env, "com/nan/thread/Inform", &g_obj);
+	initClassHelper(env, &gInformClass, INFORM_INIT, &g_obj);
     NativeTManager* tm = new NativeTManager(g_obj);
-	return reinterpret_cast<jint>(tm);
+	return static_cast<jlong>(reinterpret_cast<intptr_t>(tm));
 }//end function
 
+//----------- Named loopers --------------
+
+enum {
+	MAX_NAMED_LOOPERS = 16
+};
+
+// Started on first use and kept for the life of the process.
+static Mutex gNamedLoopersLock;
+static NativeTManager* gNamedLoopers[MAX_NAMED_LOOPERS];
+static int gNamedLooperCount = 0;
+
+static NativeTManager* obtainNamedLooper(JNIEnv* env, const char* name)
+{
+	AutoMutex _l(gNamedLoopersLock);
+	for (int i = 0; i < gNamedLooperCount; i++) {
+		if (strcmp(gNamedLoopers[i]->getName(), name) == 0) {
+			return gNamedLoopers[i];
+		}
+	}
+	if (gNamedLooperCount == MAX_NAMED_LOOPERS) {
+		ALOGE("obtainNamedLooper: no room for looper %s", name);
+		return NULL;
+	}
+	if (g_obj == NULL) {
+		initClassHelper(env, &gInformClass, INFORM_INIT, &g_obj);
+	}
+	NativeTManager* tm = new NativeTManager(g_obj, name);
+	tm->start();
+	gNamedLoopers[gNamedLooperCount++] = tm;
+	return tm;
+}
+
+static jlong nativeObtainLooper(JNIEnv* env, jobject obj, jstring name)
+{
+	if (name == NULL) {
+		return 0;
+	}
+	const char* chars = env->GetStringUTFChars(name, NULL);
+	if (chars == NULL) {
+		return 0;
+	}
+	NativeTManager* tm = obtainNamedLooper(env, chars);
+	env->ReleaseStringUTFChars(name, chars);
+	return static_cast<jlong>(reinterpret_cast<intptr_t>(tm));
+}
+
+static const char* const kActivityClass = "com/nan/thread/MyThreadActivity";
+
+static const JNINativeMethod gActivityMethods[] = {
+	{ "stringFromJNI",    "()Ljava/lang/String;",          (void*) nativeStringFromJNI },
+	{ "nativeInit",       "()J",                           (void*) nativeInit },
+	{ "nativeStart",      "(J)I",                          (void*) nativeStart },
+	{ "nativeSendMsg",    "(J)I",                          (void*) nativeSendMsg },
+	{ "nativeSendBuffer", "(JLjava/nio/ByteBuffer;II)I",   (void*) nativeSendBuffer },
+	{ "nativeSetBatching","(JZ)V",                         (void*) nativeSetBatching },
+	{ "nativeObtainLooper",   "(Ljava/lang/String;)J",              (void*) nativeObtainLooper },
+	{ "nativeSendMessage",    "(JIIILjava/nio/ByteBuffer;IIJ)I",    (void*) nativeSendMessage },
+	{ "nativeRemoveMessages", "(JI)V",                              (void*) nativeRemoveMessages },
+};
+
+//Optional: only apps that declare the @CriticalNative variant have it.
+static const JNINativeMethod gActivityCriticalMethods[] = {
+	{ "nativeSendMsgCritical", "(J)I", (void*) nativeSendMsgCritical },
+};
+
+extern "C"{
+	JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved);
+}
+
 //
 extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved){  
-	g_jvm = vm;
+	JNIEnvCache::setJavaVM(vm);
 	JNIEnv* env = NULL;    
 	jint result = -1;
 	
@@ -200,7 +565,18 @@ extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved){
 		return result;    
 	}    
 
-	//initClassHelper(env, "com/nan/thread/Inform", &g_obj);
+	// Bind natives explicitly: no dynamic symbol lookup on first call.
+	if (JNIBindings::registerNatives(env, kActivityClass, gActivityMethods,
+			sizeof(gActivityMethods) / sizeof(gActivityMethods[0])) != NO_ERROR) {
+		return result;
+	}
+	JNIBindings::registerNatives(env, kActivityClass, gActivityCriticalMethods,
+			sizeof(gActivityCriticalMethods) / sizeof(gActivityCriticalMethods[0]), true);
+
+	// Look classes up here: FindClass() on a native thread would not see them.
+	JNIBindings::add(&gInformClass);
+	JNIBindings::add(&gCForCallClass);
+	JNIBindings::resolveAll(env);
 
 	return JNI_VERSION_1_6;
 }//end function
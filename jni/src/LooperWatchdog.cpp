@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LooperWatchdog.h"
+#include "Condition.h"
+#include "Mutex.h"
+#include "Thread.h"
+#include "logging.h"
+
+#include <inttypes.h>
+#include <unistd.h>
+
+namespace ThreadManager{
+
+int32_t gLooperWatchdogRunning = 0;
+
+// Every Watch, and the watchdog configuration, under gWatchdogLock.
+static Mutex gWatchdogLock("LooperWatchdog");
+static Condition gWatchdogCondition;
+static LooperWatchdog::Watch* gWatches = NULL;
+static nsecs_t gThreshold = 0;
+static LooperWatchdog::Callback gCallback = NULL;
+static void* gCookie = NULL;
+static Thread* gMonitor = NULL;
+
+// Bounds for how often the monitor scans.
+static const nsecs_t MIN_SCAN_INTERVAL = 1000000LL;
+static const nsecs_t MAX_SCAN_INTERVAL = 1000000000LL;
+
+//-------- Watch -------
+
+LooperWatchdog::Watch::Watch(LooperInterface* looper)
+		: mNext(NULL), mLooper(looper), mSeq(0), mStart(0), mHandler(NULL),
+		  mWhat(0), mDepth(0), mTid(0), mReportedSeq(0){
+	AutoMutex _l(gWatchdogLock);
+	mNext = gWatches;
+	gWatches = this;
+}
+
+LooperWatchdog::Watch::~Watch(){
+	AutoMutex _l(gWatchdogLock);
+	for (Watch** p = &gWatches; *p != NULL; p = &(*p)->mNext) {
+		if (*p == this) {
+			*p = mNext;
+			break;
+		}
+	}
+}
+
+void LooperWatchdog::Watch::begin(MessageHandlerInterface* handler, int32_t what,
+		size_t queueDepth){
+	if (mTid == 0) {
+		mTid = gettid();
+	}
+	uint32_t seq = mSeq;
+	__atomic_store_n(&mSeq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	mHandler = handler;
+	mWhat = what;
+	mDepth = queueDepth;
+	mStart = systemTime(SYSTEM_TIME_FAST);
+	__atomic_store_n(&mSeq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void LooperWatchdog::Watch::end(){
+	uint32_t seq = mSeq;
+	__atomic_store_n(&mSeq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	mStart = 0;
+	__atomic_store_n(&mSeq, seq + 2, __ATOMIC_RELEASE);
+}
+
+//-------- Monitor -------
+
+class LooperWatchdog::MonitorThread : public Thread {
+public:
+	MonitorThread() : Thread(false) {}
+
+private:
+	virtual bool threadLoop() {
+		AutoMutex _l(gWatchdogLock);
+		if (!gLooperWatchdogRunning) {
+			return false;
+		}
+		nsecs_t interval = LooperWatchdog::scan();
+		gWatchdogCondition.waitRelative(gWatchdogLock, interval);
+		return true;
+	}
+};
+
+// Flags dispatches over the threshold; returns how long to sleep.
+// gWatchdogLock must be held.
+nsecs_t LooperWatchdog::scan(){
+	nsecs_t now = systemTime(SYSTEM_TIME_FAST);
+	for (Watch* w = gWatches; w != NULL; w = w->mNext) {
+		uint32_t seq = __atomic_load_n(&w->mSeq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			continue;
+		}
+		SlowDispatch dispatch;
+		nsecs_t start = w->mStart;
+		dispatch.looper = w->mLooper;
+		dispatch.handler = w->mHandler;
+		dispatch.what = w->mWhat;
+		dispatch.queueDepth = w->mDepth;
+		dispatch.tid = w->mTid;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&w->mSeq, __ATOMIC_RELAXED) != seq) {
+			continue;	// changed under us; look again next time
+		}
+		if (start == 0 || seq == w->mReportedSeq || now - start < gThreshold) {
+			continue;
+		}
+		w->mReportedSeq = seq;
+		dispatch.elapsed = now - start;
+
+		ALOGW("Looper %p (tid %d): handler %p has been dispatching what=%d for %" PRId64
+				"ms, %zu messages queued behind it",
+				dispatch.looper, dispatch.tid, dispatch.handler, dispatch.what,
+				ns2ms(dispatch.elapsed), dispatch.queueDepth);
+		if (gCallback != NULL) {
+			gCallback(dispatch, gCookie);
+		}
+	}
+
+	nsecs_t interval = gThreshold / 2;
+	if (interval < MIN_SCAN_INTERVAL) {
+		interval = MIN_SCAN_INTERVAL;
+	} else if (interval > MAX_SCAN_INTERVAL) {
+		interval = MAX_SCAN_INTERVAL;
+	}
+	return interval;
+}
+
+status_t LooperWatchdog::start(nsecs_t threshold, Callback callback, void* cookie){
+	if (threshold <= 0) {
+		return BAD_VALUE;
+	}
+	Thread* monitor = NULL;
+	{
+		AutoMutex _l(gWatchdogLock);
+		gThreshold = threshold;
+		gCallback = callback;
+		gCookie = cookie;
+		if (gMonitor != NULL) {
+			// already running; the new settings apply from the next scan
+			gWatchdogCondition.signal();
+			return NO_ERROR;
+		}
+		monitor = gMonitor = new MonitorThread();
+		__atomic_store_n(&gLooperWatchdogRunning, 1, __ATOMIC_RELAXED);
+	}
+	status_t result = monitor->run("LooperWatchdog");
+	if (result != NO_ERROR) {
+		AutoMutex _l(gWatchdogLock);
+		__atomic_store_n(&gLooperWatchdogRunning, 0, __ATOMIC_RELAXED);
+		gMonitor = NULL;
+		delete monitor;
+	}
+	return result;
+}
+
+void LooperWatchdog::stop(){
+	Thread* monitor;
+	{
+		AutoMutex _l(gWatchdogLock);
+		monitor = gMonitor;
+		gMonitor = NULL;
+		__atomic_store_n(&gLooperWatchdogRunning, 0, __ATOMIC_RELAXED);
+		gWatchdogCondition.signal();
+	}
+	if (monitor != NULL) {
+		monitor->requestExitAndWait();
+		delete monitor;
+	}
+}
+
+}//namespace ThreadManager
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBS_LOOPERWATCHDOG_H
+#define _LIBS_LOOPERWATCHDOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "Errors.h"
+#include "Timers.h"
+
+namespace ThreadManager{
+
+class LooperInterface;
+class MessageHandlerInterface;
+
+// Non-zero while the watchdog runs; loopers only time dispatches then.
+extern int32_t gLooperWatchdogRunning;
+
+/*
+ * A dispatch that has been running for longer than the threshold.
+ */
+struct SlowDispatch {
+	LooperInterface* looper;
+	MessageHandlerInterface* handler;
+	int32_t what;
+	size_t queueDepth;		// messages queued behind it when it started
+	pid_t tid;				// the looper thread
+	nsecs_t elapsed;		// how long it has been running so far
+};
+
+/*
+ * Watches every looper for slow dispatches from one shared monitor thread.
+ * Dispatch durations per handler are kept by MessageStats.
+ *
+ * Loopers publish the start of each dispatch in their Watch without taking
+ * a lock; the monitor scans them every half threshold and reports each slow
+ * dispatch once, while it is still running.
+ */
+class LooperWatchdog {
+public:
+	typedef void (*Callback)(const SlowDispatch& dispatch, void* cookie);
+
+	/**
+     * Start the monitor thread.  Dispatches running longer than threshold
+     * are logged and, if callback is set, passed to it on the monitor thread.
+     * The callback must not create or destroy loopers.
+     */
+	static status_t start(nsecs_t threshold, Callback callback = NULL, void* cookie = NULL);
+
+	/**
+     * Stop the monitor thread.
+     */
+	static void stop();
+
+	static inline bool isRunning() {
+		return __builtin_expect(__atomic_load_n(&gLooperWatchdogRunning, __ATOMIC_RELAXED), 0);
+	}
+
+	// Per-looper dispatch state, embedded in the looper.
+	class Watch {
+	public:
+		explicit Watch(LooperInterface* looper);
+		~Watch();
+
+		// Called by the looper thread around dispatchMessage().
+		void begin(MessageHandlerInterface* handler, int32_t what, size_t queueDepth);
+		void end();
+
+	private:
+		friend class LooperWatchdog;
+
+		Watch* mNext;
+		LooperInterface* const mLooper;
+
+		// Written by the looper thread only.  mSeq is odd while the fields
+		// below change, and advances once per begin() and end().
+		volatile uint32_t mSeq;
+		volatile nsecs_t mStart;		// 0 while idle
+		MessageHandlerInterface* volatile mHandler;
+		volatile int32_t mWhat;
+		volatile size_t mDepth;
+		volatile pid_t mTid;
+
+		uint32_t mReportedSeq;			// monitor only: last dispatch flagged
+	};
+
+private:
+	class MonitorThread;
+	friend class MonitorThread;
+
+	static nsecs_t scan();
+};
+
+}//namespace ThreadManager
+
+#endif //_LIBS_LOOPERWATCHDOG_H
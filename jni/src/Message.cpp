@@ -1,69 +1,163 @@
-/*
- * Copyright (C) ThreadManager Module Project.
- * @Author chenglan@ucweb.com 
- * @Date 2014-12-30
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-
-#include "Message.h"
-#include "MessageHandler.h"
-#include "logging.h"
-
-namespace ThreadManager{
-
-
-bool Message::setTarget(MessageHandlerInterface* target){
-	mTarget = target;
-	return 0;
-}
-
-void Message::sendToTarget(){
-
-}
-
-void Message::setData(void* mData){
-
-}
-
-void Message::recycle(){
-	delete this;
-}
-
-inline nsecs_t Message::getWhen()const{return when;}
-
-
-inline MessageHandlerInterface* Message::getTarget()const{
-	return mTarget;
-}
-
-Message* Message::createMessage(MessageHandlerInterface* target){
-	Message* msg = new Message();
-	if(NULL == msg){
-		return NULL;
-	}
-	msg->flags = FLAG_FREE;
-	msg->mTarget = target;
-	int i = 5;
-	msg->mData = reinterpret_cast<int*>(&i);
-	msg->when = systemTime(SYSTEM_TIME_MONOTONIC);
-	msg->type = TYPE_HAVE_CALLBACK;
-	return msg;
-}
-
-inline void Message::markInUse(){
-	flags |= FLAG_IN_USE;
-}
-
-inline int32_t Message::getType()const{
-	return type;
-}
-
-
-
-}//namespace ThreadManager
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Message.h"
+#include "MessageHandler.h"
+#include "logging.h"
+#include "Futex.h"
+
+namespace ThreadManager{
+
+Message::Message()
+		: when(0)
+		, mTarget(NULL)
+		, what(0)
+		, arg1(0)
+		, arg2(0)
+		, type(TYPE_HAVE_CALLBACK)
+		, flags(FLAG_FREE)
+		, mSize(0)
+		, mCallback(NULL)
+		, mData(NULL)
+		, mToken(NULL)
+		, mReplyState(REPLY_NONE)
+		, mReplyResult(0)
+		, mRefs(1){
+}
+
+void Message::sendToTarget(){
+
+}
+
+void Message::setData(void* mData){
+	setPayload(mData, 0, NULL);
+}
+
+void Message::setPayload(void* data, size_t size, PayloadToken* token){
+	if (mToken != NULL && mToken != token) {
+		mToken->release();
+	}
+	mData = data;
+	mSize = (int32_t) size;
+	mToken = token;
+}
+
+// Spins before the sender sleeps; a reply often comes back that fast.
+static const int32_t MAX_REPLY_SPINS = 100;
+
+void Message::recycle(){
+	// Dispatched or removed without an answer: do not leave the sender hanging.
+	complete(REPLY_DROPPED, 0);
+	if (__atomic_sub_fetch(&mRefs, 1, __ATOMIC_ACQ_REL) != 0) {
+		return;
+	}
+	// The payload is no longer needed once the message has been dispatched.
+	if (mToken != NULL) {
+		mToken->release();
+		mToken = NULL;
+	}
+	delete this;
+}
+
+bool Message::reply(int32_t result)const{
+	return complete(REPLY_DONE, result);
+}
+
+bool Message::complete(int32_t state, int32_t result)const{
+	// Claim the completion so that only the first answer is kept.
+	int32_t old = __atomic_load_n(&mReplyState, __ATOMIC_RELAXED);
+	do {
+		if (old != REPLY_PENDING && old != REPLY_WAITING) {
+			return false;
+		}
+	} while (!__atomic_compare_exchange_n(&mReplyState, &old, REPLY_CLAIMED, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+	mReplyResult = result;
+	__atomic_store_n(&mReplyState, state, __ATOMIC_RELEASE);
+	if (old == REPLY_WAITING) {
+		futexWake(&mReplyState, 1);
+	}
+	return true;
+}
+
+void Message::prepareRequest(){
+	mReplyResult = 0;
+	__atomic_store_n(&mReplyState, REPLY_PENDING, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&mRefs, 1, __ATOMIC_RELAXED);
+}
+
+status_t Message::waitForReply(nsecs_t timeout, int32_t* result){
+	nsecs_t deadline = timeout < 0 ? -1 : systemTime(SYSTEM_TIME_MONOTONIC) + timeout;
+	int32_t state;
+	int32_t spins = 0;
+	while ((state = __atomic_load_n(&mReplyState, __ATOMIC_ACQUIRE)) == REPLY_PENDING
+			|| state == REPLY_WAITING || state == REPLY_CLAIMED) {
+		if (spins < MAX_REPLY_SPINS || state == REPLY_CLAIMED) {
+			cpuRelax();
+			spins++;
+			continue;
+		}
+		if (state == REPLY_PENDING && !__atomic_compare_exchange_n(&mReplyState, &state,
+				REPLY_WAITING, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+			continue;
+		}
+		if (deadline < 0) {
+			futexWait(&mReplyState, REPLY_WAITING, NULL);
+			continue;
+		}
+		if (systemTime(SYSTEM_TIME_MONOTONIC) >= deadline) {
+			return TIMED_OUT;
+		}
+		struct timespec ts;
+		ts.tv_sec = deadline / 1000000000LL;
+		ts.tv_nsec = deadline % 1000000000LL;
+		futexWaitUntil(&mReplyState, REPLY_WAITING, &ts);
+	}
+	if (state == REPLY_DROPPED) {
+		return DEAD_OBJECT;
+	}
+	if (result != NULL) {
+		*result = mReplyResult;
+	}
+	return NO_ERROR;
+}
+
+Message* Message::createMessage(MessageHandlerInterface* target){
+	return createMessage(target, 0, 0, 0);
+}
+
+Message* Message::createMessage(MessageHandlerInterface* target,
+		int32_t what, int32_t arg1, int32_t arg2){
+	Message* msg = new Message();
+	if(NULL == msg){
+		return NULL;
+	}
+	msg->what = what;
+	msg->arg1 = arg1;
+	msg->arg2 = arg2;
+	msg->mTarget = target;
+	msg->when = systemTime(SYSTEM_TIME_MONOTONIC);
+	return msg;
+}
+
+Message* Message::createMessage(Runnable* callback){
+	Message* msg = createMessage((MessageHandlerInterface*) NULL);
+	if (msg != NULL) {
+		msg->mCallback = callback;
+	}
+	return msg;
+}
+
+
+
+}//namespace ThreadManager
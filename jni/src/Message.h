@@ -1,83 +1,251 @@
-/*
- * Copyright (C) ThreadManager Module Project.
- * @Author chenglan@ucweb.com 
- * @Date 2014-12-30
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-
-#ifndef _LIBS_MESSAGE_H
-#define _LIBS_MESSAGE_H
-
-#include "Timers.h"
-
-namespace ThreadManager{
-
-class MessageHandlerInterface;
-
-template <typename T>
-struct Link {
-	T* next;
-	T* prev;
-protected:
-	inline Link() : next(NULL), prev(NULL) { }
-};
-
-
-class MessageInterface {
-public:
-	virtual ~MessageInterface(){}
-
-	virtual MessageHandlerInterface* getTarget()const=0;
-	virtual bool setTarget(MessageHandlerInterface* target)=0;
-	virtual void sendToTarget()=0;
-	virtual void setData(void* mData)=0;
-	virtual nsecs_t getWhen()const=0;
-	virtual void recycle()=0;
-	virtual void markInUse()=0;
-	virtual int32_t getType()const=0;
-
-};
-
-class Message : public Link<Message>, public MessageInterface{
-public:
-	enum{
-		TYPE_HAVE_CALLBACK,
-		TYPE_NO_RECEIVER
-	};
-
-	enum{
-		FLAG_IN_USE = 1<<0,
-		FLAG_FREE   = 1<<1
-	};
-	Message(){}
-	virtual ~Message(){}
-	virtual bool setTarget(MessageHandlerInterface* target);
-	virtual void sendToTarget();
-	virtual void setData(void* mData);
-	virtual void recycle();
-	virtual MessageHandlerInterface* getTarget()const;
-	static Message* createMessage(MessageHandlerInterface* target);
-	virtual nsecs_t getWhen()const;
-	virtual void markInUse();
-	virtual int32_t getType()const;
-
-private:
-	nsecs_t when;
-	MessageHandlerInterface* mTarget;
-	int32_t flags;
-	int32_t mSize;
-	void* mData;
-	int32_t type;
-};
-
-
-}//namespace ThreadManager
-
-#endif
-
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_MESSAGE_H
+#define _LIBS_MESSAGE_H
+
+#include <stddef.h>
+
+#include "Timers.h"
+#include "Errors.h"
+#include "SmallFunction.h"
+
+namespace ThreadManager{
+
+class MessageHandlerInterface;
+
+/*
+ * Keeps a message payload alive while the message is queued.  Released
+ * once, on the looper thread, when the message is recycled after dispatch.
+ */
+class PayloadToken {
+public:
+	virtual ~PayloadToken(){}
+	virtual void release()=0;
+};
+
+/*
+ * Work a message carries for the looper to run in place of a handler,
+ * as a Runnable callback does for android.os.Message.
+ */
+class Runnable {
+public:
+	virtual ~Runnable(){}
+	virtual void run()=0;
+};
+
+template <typename T>
+struct Link {
+	T* next;
+	T* prev;
+protected:
+	inline Link() : next(NULL), prev(NULL) { }
+};
+
+
+/*
+ * Virtual view of a Message, for code that wants an interface.  Message
+ * itself has no virtuals; wrap one in a MessageAdapter to get this.
+ */
+class MessageInterface {
+public:
+	virtual ~MessageInterface(){}
+
+	virtual MessageHandlerInterface* getTarget()const=0;
+	virtual bool setTarget(MessageHandlerInterface* target)=0;
+	virtual void sendToTarget()=0;
+	virtual void setData(void* mData)=0;
+	virtual void setPayload(void* data, size_t size, PayloadToken* token)=0;
+	virtual void* getData()const=0;
+	virtual size_t getDataSize()const=0;
+	virtual nsecs_t getWhen()const=0;
+	virtual void recycle()=0;
+	virtual void markInUse()=0;
+	virtual int32_t getType()const=0;
+	virtual int32_t getWhat()const=0;
+	virtual int32_t getArg1()const=0;
+	virtual int32_t getArg2()const=0;
+	virtual bool reply(int32_t result)const=0;
+
+};
+
+/*
+ * The message itself.  Final and without virtuals: the queue's sorted
+ * insert and the looper read it on every message, so the accessors are
+ * inline and the fields they touch (the links, when, target, what) lie
+ * within the first 64 bytes.  Messages come from plain new, which only
+ * aligns to 16 bytes, so that span may still cross two cache lines.
+ */
+class Message final : public Link<Message> {
+public:
+	enum{
+		TYPE_HAVE_CALLBACK,
+		TYPE_NO_RECEIVER
+	};
+
+	enum{
+		FLAG_IN_USE = 1<<0,
+		FLAG_FREE   = 1<<1
+	};
+	bool setTarget(MessageHandlerInterface* target){ mTarget = target; return 0; }
+	void sendToTarget();
+	void setData(void* mData);
+	void setPayload(void* data, size_t size, PayloadToken* token);
+	void* getData()const{ return mData; }
+	size_t getDataSize()const{ return (size_t) mSize; }
+	void recycle();
+	MessageHandlerInterface* getTarget()const{ return mTarget; }
+	static Message* createMessage(MessageHandlerInterface* target);
+	static Message* createMessage(MessageHandlerInterface* target,
+			int32_t what, int32_t arg1, int32_t arg2);
+	//A message with no target; the looper runs callback instead.
+	static Message* createMessage(Runnable* callback);
+	nsecs_t getWhen()const{ return when; }
+	void markInUse(){ flags |= FLAG_IN_USE; }
+	int32_t getType()const{ return type; }
+	int32_t getWhat()const{ return what; }
+	int32_t getArg1()const{ return arg1; }
+	int32_t getArg2()const{ return arg2; }
+
+	//User-defined code and arguments, as on android.os.Message.
+	void setWhat(int32_t what){ this->what = what; }
+	void setArgs(int32_t arg1, int32_t arg2){ this->arg1 = arg1; this->arg2 = arg2; }
+
+	//Due time, SYSTEM_TIME_MONOTONIC.  Set by the queue on enqueue.
+	void setWhen(nsecs_t when){ this->when = when; }
+
+	//Run by the looper instead of dispatching to the target.
+	Runnable* getCallback()const{ return mCallback; }
+
+	enum{
+		//Captures up to this size are stored in the message itself.
+		CALLABLE_CAPACITY = 4 * sizeof(void*)
+	};
+
+	typedef SmallFunction<void(), CALLABLE_CAPACITY> Callable;
+
+	/**
+     * Give the message a closure for the looper to call instead of
+     * dispatching it.  Only captures bigger than CALLABLE_CAPACITY, or
+     * that can't be moved without throwing, cost an allocation.
+     */
+	template <typename F>
+	void setCallable(F&& fn){
+		mCallable = Callable(std::forward<F>(fn));
+	}
+
+	bool hasCallable()const{ return (bool) mCallable; }
+
+	void runCallable(){ mCallable(); }
+
+	/**
+     * Answer a message sent with sendMessageAndWait(), waking the sender.
+     * Only the first reply counts; returns false if the message is not a
+     * request or was already answered.
+     */
+	bool reply(int32_t result)const;
+
+	/**
+     * Turn the message into a request and take the sender's reference, so
+     * it outlives dispatch until the sender is done with it.
+     */
+	void prepareRequest();
+
+	/**
+     * Block until reply() or recycle(), or until timeout (ns, negative
+     * waits forever) elapses.  Returns NO_ERROR with the reply in *result,
+     * DEAD_OBJECT if the message was recycled unanswered, or TIMED_OUT.
+     */
+	status_t waitForReply(nsecs_t timeout, int32_t* result);
+
+private:
+	//Messages are reference counted and delete themselves on the last
+	//recycle(); get one from createMessage().
+	Message();
+	~Message(){}
+	Message(const Message&);
+	Message& operator = (const Message&);
+
+	enum{
+		REPLY_NONE,		// not a request
+		REPLY_PENDING,
+		REPLY_WAITING,	// pending, and the sender sleeps on the futex
+		REPLY_CLAIMED,	// being answered
+		REPLY_DONE,
+		REPLY_DROPPED	// recycled without a reply
+	};
+
+	bool complete(int32_t state, int32_t result)const;
+
+	//Hot: read for every message by the queue and the looper; with next
+	//and prev from Link they fit in a 64-byte span.
+	nsecs_t when;
+	MessageHandlerInterface* mTarget;
+	int32_t what;
+	int32_t arg1;
+	int32_t arg2;
+	int32_t type;
+	int32_t flags;
+	int32_t mSize;
+
+	//Cold: payloads, callbacks and requests.
+	Runnable* mCallback;
+	void* mData;
+	PayloadToken* mToken;
+
+	//Request completion: a futex word, and the reply it guards.
+	mutable volatile int32_t mReplyState;
+	mutable int32_t mReplyResult;
+
+	//The queue's reference, plus the sender's for a request.
+	volatile int32_t mRefs;
+
+	Callable mCallable;
+};
+
+/*
+ * MessageInterface over a Message, for callers that want the interface.
+ */
+class MessageAdapter : public MessageInterface {
+public:
+	explicit MessageAdapter(Message* msg) : mMessage(msg){}
+
+	Message* get()const{ return mMessage; }
+
+	virtual MessageHandlerInterface* getTarget()const{ return mMessage->getTarget(); }
+	virtual bool setTarget(MessageHandlerInterface* target){ return mMessage->setTarget(target); }
+	virtual void sendToTarget(){ mMessage->sendToTarget(); }
+	virtual void setData(void* data){ mMessage->setData(data); }
+	virtual void setPayload(void* data, size_t size, PayloadToken* token){
+		mMessage->setPayload(data, size, token);
+	}
+	virtual void* getData()const{ return mMessage->getData(); }
+	virtual size_t getDataSize()const{ return mMessage->getDataSize(); }
+	virtual nsecs_t getWhen()const{ return mMessage->getWhen(); }
+	virtual void recycle(){ mMessage->recycle(); }
+	virtual void markInUse(){ mMessage->markInUse(); }
+	virtual int32_t getType()const{ return mMessage->getType(); }
+	virtual int32_t getWhat()const{ return mMessage->getWhat(); }
+	virtual int32_t getArg1()const{ return mMessage->getArg1(); }
+	virtual int32_t getArg2()const{ return mMessage->getArg2(); }
+	virtual bool reply(int32_t result)const{ return mMessage->reply(result); }
+
+private:
+	Message* mMessage;
+};
+
+
+}//namespace ThreadManager
+
+#endif
+
@@ -1,145 +1,273 @@
-/*
- * Copyright (C) ThreadManager Module Project.
- * @Author chenglan@ucweb.com 
- * @Date 2014-12-30
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-
-#include "MessageQueue.h"
-#include "Mutex.h"
-#include "logging.h"
-
-namespace ThreadManager{
-
-template<typename T>
-inline static T min(const T& a, const T& b) {
-    return a < b ? a : b;
-}
-
-//-------- MesagePublisher -------
-
-MessagePublisher::MessagePublisher(MessageHandler::Callback* queue)
-					:mQueue(queue)
-{
-	ALOGD("Thread number %ld function= %s line=%d\n", pthread_self(),__FUNCTION__,__LINE__);
-}
-
-MessagePublisher::~MessagePublisher(){
-}
-
-bool MessagePublisher::publishMessage(const Message& msg,nsecs_t when){
-	return mQueue->enqueueMessage(msg,when);
-}
-
-bool MessagePublisher::publishRawData(const void * data){
-return 0;
-}
-
-//--------- MessageQueue ----------
-MessageQueue::MessageQueue(){
-	this->init();
-}
-
-MessageQueue::~MessageQueue(){
-	delete mPoll;
-	mPoll = NULL;
-}
-
-void MessageQueue::pollOnce(int timeoutMillis){
-    mPoll->pollOnce(timeoutMillis);
-}
-
-void MessageQueue::wake(){
-	mPoll->wake();
-}
-
-void MessageQueue::init(){
-	mPoll = Poll::getForThread();
-    if (NULL == mPoll) {
-        mPoll = new Poll(false);
-        Poll::setForThread(mPoll);
-    }
-}
-
-bool MessageQueue::enqueueMessage(const Message& msg,long when){
-	if(NULL == msg.getTarget()){
-		ALOGE("Can't get the MessageQueue! Funtion =%s Line=%d ",__FUNCTION__,__LINE__);
-		return false;
-	}
-	bool needWake;
-	{//acquire lock
-		AutoMutex _l(mLock);
-		
-		needWake = mInboundQueue.isEmpty();
-		
-		mInboundQueue.enqueueAtTimeOut(const_cast<Message*>(&msg), when);
-		
-	}//release lock
-
-	if(needWake){
-		mPoll->wake();
-	}
-	return 0;
-}
-
-void MessageQueue::removeMessages(MessageHandlerInterface* mHandler,Message& msg){
-
-}
-
-MessageInterface* MessageQueue::next(){
-	int32_t nextPollTimeoutMillis = -1;
-	for(;;){
-		this->pollOnce(nextPollTimeoutMillis);
-		ALOGI("FUNCTION=%s line=%d",__FUNCTION__,__LINE__);
-		{//acquire lock
-			AutoMutex _l(mLock);
-			
-			// Try to retrieve the next message.  Return if found.
-            nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-            
-			if(mInboundQueue.isEmpty()){
-				nextPollTimeoutMillis = -1;
-				ALOGE("FUNCTION=%s line=%d",__FUNCTION__,__LINE__);
-			}else{
-				Message* msg = mInboundQueue.dequeueAtHead();
-            	if (NULL != msg && msg->getTarget() == NULL) {
-                	// Stalled by a barrier.  Find the next asynchronous message in the queue.
-					ALOGE("The msg can't set the callbacker.");
-            	}
-				
-            	if (NULL != msg) {
-					if (now < msg->getWhen()) {
-						// Next message is not ready.  Set a timeout to wake up when it is ready.
-                    	nextPollTimeoutMillis = min((int32_t)(msg->getWhen() - now), MAX_VALUE);
-                	} else {
-                    	// Got a message.
-                    	mBlock = false;              
-                    	msg->next = NULL;
-#if 1
-						ALOGV("MessageQueue,Returning message: %p" , msg);
-#endif
-                    	msg->markInUse();
-                    	return msg;
-                	}
-            	} else {
-                	// No more messages.
-                	ALOGE("FUNCTION=%s line=%d",__FUNCTION__,__LINE__);
-                	nextPollTimeoutMillis = -1;
-            	}
-			}
-		}//release lock
-	}
-	return NULL;
-}
-
-bool MessageQueue::quit(){
-	return 0;
-}
-
-}//namespace ThreadManager
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "MessageQueue.h"
+#include "Mutex.h"
+#include "MessageTrace.h"
+#include "logging.h"
+
+// Walks the whole queue after removals; set to 1 when chasing list corruption.
+#define DEBUG_QUEUE_LINKS 0
+
+namespace ThreadManager{
+
+template<typename T>
+inline static T min(const T& a, const T& b) {
+    return a < b ? a : b;
+}
+
+//-------- MesagePublisher -------
+
+MessagePublisher::MessagePublisher(MessageHandler::Callback* queue)
+					:mQueue(queue)
+{
+	ALOGD("Thread number %ld function= %s line=%d\n", pthread_self(),__FUNCTION__,__LINE__);
+}
+
+MessagePublisher::~MessagePublisher(){
+}
+
+bool MessagePublisher::publishMessage(const Message& msg,nsecs_t when){
+	return mQueue->enqueueMessage(msg,when);
+}
+
+void MessagePublisher::removeMessages(MessageHandlerInterface* handler,int32_t what){
+	mQueue->removeMessages(handler,what);
+}
+
+bool MessagePublisher::publishRawData(const void * data){
+return 0;
+}
+
+//--------- MessageQueue ----------
+MessageQueue::MessageQueue(){
+	this->init();
+}
+
+MessageQueue::~MessageQueue(){
+	delete mPoll;
+	mPoll = NULL;
+}
+
+void MessageQueue::pollOnce(int timeoutMillis){
+    mPoll->pollOnce(timeoutMillis);
+}
+
+void MessageQueue::wake(){
+	mPoll->wake();
+}
+
+size_t MessageQueue::getDepth() const{
+	return __atomic_load_n(&mDepth, __ATOMIC_RELAXED);
+}
+
+bool MessageQueue::addIdleHandler(IdleHandler* handler){
+	AutoMutex _l(mLock);
+	for (size_t i = 0; i < mIdleHandlerCount; i++) {
+		if (mIdleHandlers[i] == handler) {
+			return true;
+		}
+	}
+	if (mIdleHandlerCount == MAX_IDLE_HANDLERS) {
+		ALOGE("Too many idle handlers on MessageQueue %p.", this);
+		return false;
+	}
+	mIdleHandlers[mIdleHandlerCount++] = handler;
+	return true;
+}
+
+void MessageQueue::removeIdleHandler(IdleHandler* handler){
+	AutoMutex _l(mLock);
+	for (size_t i = 0; i < mIdleHandlerCount; i++) {
+		if (mIdleHandlers[i] == handler) {
+			mIdleHandlers[i] = mIdleHandlers[--mIdleHandlerCount];
+			return;
+		}
+	}
+}
+
+void MessageQueue::runIdleHandlers(){
+	IdleHandler* handlers[MAX_IDLE_HANDLERS];
+	size_t count;
+	{//acquire lock
+		AutoMutex _l(mLock);
+		count = mIdleHandlerCount;
+		for (size_t i = 0; i < count; i++) {
+			handlers[i] = mIdleHandlers[i];
+		}
+	}//release lock
+
+	// Called without the lock, so a handler may send messages.
+	for (size_t i = 0; i < count; i++) {
+		if (!handlers[i]->queueIdle()) {
+			removeIdleHandler(handlers[i]);
+		}
+	}
+}
+
+void MessageQueue::init(){
+	mBlock = false;
+	mDepth = 0;
+	mIdleHandlerCount = 0;
+	mPoll = Poll::getForThread();
+    if (NULL == mPoll) {
+        mPoll = new Poll(false);
+        Poll::setForThread(*mPoll);
+    }
+}
+
+bool MessageQueue::enqueueMessage(const Message& msg,nsecs_t when){
+	MessageHandlerInterface* target = msg.getTarget();
+	if(NULL == target && NULL == msg.getCallback()){
+		ALOGE("Can't get the MessageQueue! Funtion =%s Line=%d ",__FUNCTION__,__LINE__);
+		return false;
+	}
+	// Once queued the looper may dispatch and recycle msg at any time.
+	const int32_t what = msg.getWhat();
+	Message* entry = const_cast<Message*>(&msg);
+	bool needWake;
+	{//acquire lock
+		AutoMutex _l(mLock);
+		
+		// when == 0 puts the message at the front, but it is due right away.
+		entry->setWhen(when != 0 ? when : systemTime(SYSTEM_TIME_MONOTONIC));
+		mInboundQueue.enqueueAtTimeOut(entry, when);
+		__atomic_store_n(&mDepth, mDepth + 1, __ATOMIC_RELAXED);
+
+		// The looper only needs waking if it sleeps past the new head.
+		needWake = mBlock && mInboundQueue.head == entry;
+	}//release lock
+	MESSAGE_TRACE(MESSAGE_TRACE_ENQUEUE, entry, target, what);
+
+	if(needWake){
+		mPoll->wake();
+	}
+	return true;
+}
+
+#if DEBUG_QUEUE_LINKS
+// Every message must point back at its predecessor and the tail at the
+// last one; dequeue() from the middle of the queue relies on both.
+static void checkLinks(const MessageQueue* queue, const Message* head, const Message* tail)
+{
+	const Message* prev = NULL;
+	for (const Message* msg = head; msg != NULL; msg = msg->next) {
+		if (msg->prev != prev) {
+			ALOGE("MessageQueue %p: message %p links back to %p, not %p",
+					queue, msg, msg->prev, prev);
+		}
+		prev = msg;
+	}
+	if (tail != prev) {
+		ALOGE("MessageQueue %p: tail is %p, last message is %p",
+				queue, tail, prev);
+	}
+}
+#endif
+
+void MessageQueue::removeMessages(MessageHandlerInterface* handler,int32_t what){
+	Message* removed = NULL;
+	{//acquire lock
+		AutoMutex _l(mLock);
+#if DEBUG_QUEUE_LINKS
+		checkLinks(this, mInboundQueue.head, mInboundQueue.tail);
+#endif
+		Message* msg = mInboundQueue.head;
+		while (msg != NULL) {
+			Message* next = msg->next;
+			if (msg->getTarget() == handler && msg->getWhat() == what) {
+				mInboundQueue.dequeue(msg);
+				__atomic_store_n(&mDepth, mDepth - 1, __ATOMIC_RELAXED);
+				msg->next = removed;
+				removed = msg;
+			}
+			msg = next;
+		}
+#if DEBUG_QUEUE_LINKS
+		checkLinks(this, mInboundQueue.head, mInboundQueue.tail);
+#endif
+	}//release lock
+
+	// Recycle outside the lock; releasing a payload may call into Java.
+	while (removed != NULL) {
+		Message* next = removed->next;
+		removed->recycle();
+		removed = next;
+	}
+}
+
+// Milliseconds until the given delay has passed, rounded up.
+static int32_t toMillisecondTimeout(nsecs_t delay)
+{
+	nsecs_t millis = (delay + 999999LL) / 1000000LL;
+	return millis < MAX_VALUE ? (int32_t) millis : MAX_VALUE;
+}
+
+Message* MessageQueue::next(){
+	// Look at the queue before blocking for the first time.
+	int32_t nextPollTimeoutMillis = 0;
+	bool idleHandled = false;
+	for(;;){
+		if (nextPollTimeoutMillis != 0) {
+			this->pollOnce(nextPollTimeoutMillis);
+		}
+		ALOGV("FUNCTION=%s line=%d",__FUNCTION__,__LINE__);
+		{//acquire lock
+			AutoMutex _l(mLock);
+			
+			// Try to retrieve the next message.  Return if found.
+            nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+            Message* msg = mInboundQueue.head;
+            if (NULL != msg) {
+				if (now < msg->getWhen()) {
+					// Next message is not ready.  Set a timeout to wake up when it is ready.
+                    nextPollTimeoutMillis = toMillisecondTimeout(msg->getWhen() - now);
+                } else {
+                    // Got a message.
+                    mInboundQueue.dequeueAtHead();
+                    __atomic_store_n(&mDepth, mDepth - 1, __ATOMIC_RELAXED);
+                    mBlock = false;              
+                    msg->next = NULL;
+                    msg->prev = NULL;
+					ALOGV("MessageQueue,Returning message: %p" , msg);
+                    msg->markInUse();
+                    MESSAGE_TRACE(MESSAGE_TRACE_DEQUEUE, msg, msg->getTarget(), msg->getWhat());
+                    return msg;
+                }
+            } else {
+                // No more messages.
+                nextPollTimeoutMillis = -1;
+            }
+
+			if (idleHandled || mIdleHandlerCount == 0) {
+				// Nothing to do until a wake or the head falls due.
+				mBlock = true;
+				continue;
+			}
+		}//release lock
+
+		// About to block: give the idle handlers one go per call.
+		idleHandled = true;
+		runIdleHandlers();
+
+		// An idle handler may have sent a message; look again before blocking.
+		nextPollTimeoutMillis = 0;
+	}
+	return NULL;
+}
+
+bool MessageQueue::quit(){
+	return 0;
+}
+
+}//namespace ThreadManager
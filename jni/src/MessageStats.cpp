@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Tables are kept the way MessageTrace keeps its rings: linked once into a
+ *  global list, never freed, handed back when their thread exits and adopted
+ *  by the next looper thread that records.  Only the owning thread writes a
+ *  table; an entry's histograms are published before its handler.
+ *
+ *  forget() only marks an entry, by setting the low bit of its key.  The
+ *  owning thread hands a marked entry to the next new handler, clearing the
+ *  histograms before it publishes the new key.
+ */
+
+#include "MessageStats.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace ThreadManager{
+
+int32_t gMessageStatsEnabled = 0;
+
+// Set in the key of an entry whose handler was forgotten.
+static const uintptr_t FORGOTTEN = 1;
+
+struct StatsEntry {
+	volatile uintptr_t key;		// the handler's address, 0 while the entry is free
+	HandlerLatency* volatile latency;
+};
+
+struct StatsTable {
+	StatsTable* next;			// all tables, linked once, never unlinked
+	volatile int32_t owned;		// 1 while a thread records into the table
+	StatsEntry entries[MessageStats::MAX_HANDLERS];
+	HandlerLatency* volatile callbacks;	// messages without a target
+	HandlerLatency* volatile other;	// handlers beyond MAX_HANDLERS
+};
+
+static StatsTable* volatile gStatsTables = NULL;
+static pthread_key_t gStatsTableKey;
+static pthread_once_t gStatsTableKeyOnce = PTHREAD_ONCE_INIT;
+
+static void releaseStatsTable(void* table)
+{
+	__atomic_store_n(&((StatsTable*) table)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void initStatsTableKey()
+{
+	pthread_key_create(&gStatsTableKey, releaseStatsTable);
+}
+
+static StatsTable* adoptStatsTable()
+{
+	StatsTable* table = __atomic_load_n(&gStatsTables, __ATOMIC_ACQUIRE);
+	for (; table != NULL; table = table->next) {
+		int32_t expected = 0;
+		if (__atomic_load_n(&table->owned, __ATOMIC_RELAXED) == 0
+				&& __atomic_compare_exchange_n(&table->owned, &expected, 1, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return table;
+		}
+	}
+
+	table = (StatsTable*) calloc(1, sizeof(StatsTable));
+	if (table == NULL) {
+		return NULL;
+	}
+	table->owned = 1;
+	StatsTable* head = __atomic_load_n(&gStatsTables, __ATOMIC_RELAXED);
+	do {
+		table->next = head;
+	} while (!__atomic_compare_exchange_n(&gStatsTables, &head, table, true,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	return table;
+}
+
+static HandlerLatency* newLatency(int32_t kind, MessageHandlerInterface* handler)
+{
+	HandlerLatency* latency = new HandlerLatency();
+	latency->kind = kind;
+	latency->handler = handler;
+	return latency;
+}
+
+static HandlerLatency* latencyFor(StatsTable* table, MessageHandlerInterface* handler)
+{
+	if (handler == NULL) {
+		if (table->callbacks == NULL) {
+			__atomic_store_n(&table->callbacks,
+					newLatency(HandlerLatency::KIND_CALLBACKS, NULL), __ATOMIC_RELEASE);
+		}
+		return table->callbacks;
+	}
+
+	const uintptr_t key = (uintptr_t) handler;
+	StatsEntry* forgotten = NULL;
+	for (int i = 0; i < MessageStats::MAX_HANDLERS; i++) {
+		StatsEntry& entry = table->entries[i];
+		uintptr_t current = __atomic_load_n(&entry.key, __ATOMIC_RELAXED);
+		if (current == key) {
+			return entry.latency;
+		}
+		if (current & FORGOTTEN) {
+			if (forgotten == NULL) {
+				forgotten = &entry;
+			}
+			continue;
+		}
+		if (current == 0) {
+			if (forgotten != NULL) {
+				break;
+			}
+			entry.latency = newLatency(HandlerLatency::KIND_HANDLER, handler);
+			__atomic_store_n(&entry.key, key, __ATOMIC_RELEASE);
+			return entry.latency;
+		}
+	}
+
+	if (forgotten != NULL) {
+		HandlerLatency* latency = forgotten->latency;
+		latency->handler = handler;
+		latency->queueLatency.reset();
+		latency->dispatchTime.reset();
+		__atomic_store_n(&forgotten->key, key, __ATOMIC_RELEASE);
+		return latency;
+	}
+
+	if (table->other == NULL) {
+		__atomic_store_n(&table->other,
+				newLatency(HandlerLatency::KIND_OTHER, NULL), __ATOMIC_RELEASE);
+	}
+	return table->other;
+}
+
+void MessageStats::setEnabled(bool enabled){
+	__atomic_store_n(&gMessageStatsEnabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+void MessageStats::record(MessageHandlerInterface* handler, nsecs_t queueLatency,
+		nsecs_t dispatchTime){
+	pthread_once(&gStatsTableKeyOnce, initStatsTableKey);
+	StatsTable* table = (StatsTable*) pthread_getspecific(gStatsTableKey);
+	if (table == NULL) {
+		table = adoptStatsTable();
+		if (table == NULL) {
+			return;
+		}
+		pthread_setspecific(gStatsTableKey, table);
+	}
+
+	HandlerLatency* latency = latencyFor(table, handler);
+	latency->queueLatency.record(queueLatency);
+	latency->dispatchTime.record(dispatchTime);
+}
+
+// Calls fn for every published entry of every table, callback and overflow
+// entries included, forgotten ones left out.
+template <typename F>
+static void forEachLatency(F& fn)
+{
+	StatsTable* table = __atomic_load_n(&gStatsTables, __ATOMIC_ACQUIRE);
+	for (; table != NULL; table = table->next) {
+		for (int i = 0; i < MessageStats::MAX_HANDLERS; i++) {
+			StatsEntry& entry = table->entries[i];
+			uintptr_t key = __atomic_load_n(&entry.key, __ATOMIC_ACQUIRE);
+			if (key == 0) {
+				break;
+			}
+			if (!(key & FORGOTTEN)) {
+				fn(*entry.latency);
+			}
+		}
+		HandlerLatency* callbacks = __atomic_load_n(&table->callbacks, __ATOMIC_ACQUIRE);
+		if (callbacks != NULL) {
+			fn(*callbacks);
+		}
+		HandlerLatency* other = __atomic_load_n(&table->other, __ATOMIC_ACQUIRE);
+		if (other != NULL) {
+			fn(*other);
+		}
+	}
+}
+
+struct MergeOne {
+	HandlerLatency* out;
+	bool found;
+
+	void operator()(const HandlerLatency& latency) {
+		if (latency.kind == out->kind && latency.handler == out->handler) {
+			out->queueLatency.merge(latency.queueLatency);
+			out->dispatchTime.merge(latency.dispatchTime);
+			found = true;
+		}
+	}
+};
+
+bool MessageStats::snapshot(MessageHandlerInterface* handler, HandlerLatency* out){
+	out->kind = handler != NULL ? HandlerLatency::KIND_HANDLER : HandlerLatency::KIND_CALLBACKS;
+	out->handler = handler;
+	out->queueLatency.reset();
+	out->dispatchTime.reset();
+	MergeOne merge = { out, false };
+	forEachLatency(merge);
+	return merge.found;
+}
+
+struct MergeAll {
+	HandlerLatency* out;
+	size_t max;
+	size_t count;
+
+	void operator()(const HandlerLatency& latency) {
+		size_t i = 0;
+		while (i < count && (out[i].kind != latency.kind || out[i].handler != latency.handler)) {
+			i++;
+		}
+		if (i == count) {
+			if (count == max) {
+				return;
+			}
+			out[i].kind = latency.kind;
+			out[i].handler = latency.handler;
+			out[i].queueLatency.reset();
+			out[i].dispatchTime.reset();
+			count++;
+		}
+		out[i].queueLatency.merge(latency.queueLatency);
+		out[i].dispatchTime.merge(latency.dispatchTime);
+	}
+};
+
+size_t MessageStats::snapshot(HandlerLatency* out, size_t max){
+	MergeAll merge = { out, max, 0 };
+	forEachLatency(merge);
+	return merge.count;
+}
+
+struct ResetAll {
+	void operator()(HandlerLatency& latency) {
+		latency.queueLatency.reset();
+		latency.dispatchTime.reset();
+	}
+};
+
+void MessageStats::reset(){
+	ResetAll reset;
+	forEachLatency(reset);
+}
+
+void MessageStats::forget(MessageHandlerInterface* handler){
+	if (handler == NULL) {
+		return;
+	}
+	const uintptr_t key = (uintptr_t) handler;
+	StatsTable* table = __atomic_load_n(&gStatsTables, __ATOMIC_ACQUIRE);
+	for (; table != NULL; table = table->next) {
+		// A handler has at most one entry per table.
+		for (int i = 0; i < MessageStats::MAX_HANDLERS; i++) {
+			uintptr_t expected = key;
+			if (__atomic_compare_exchange_n(&table->entries[i].key, &expected,
+					key | FORGOTTEN, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+					|| expected == 0) {
+				break;
+			}
+		}
+	}
+}
+
+struct CountAll {
+	size_t count;
+
+	void operator()(const HandlerLatency&) {
+		count++;
+	}
+};
+
+void MessageStats::dump(int fd){
+	CountAll counter = { 0 };
+	forEachLatency(counter);
+
+	dprintf(fd, "Message latencies (recording %s):\n",
+			gMessageStatsEnabled ? "on" : "off");
+	if (counter.count == 0) {
+		return;
+	}
+	HandlerLatency* latencies = new HandlerLatency[counter.count];
+	size_t count = snapshot(latencies, counter.count);
+	for (size_t i = 0; i < count; i++) {
+		const HandlerLatency& latency = latencies[i];
+		switch (latency.kind) {
+			case HandlerLatency::KIND_HANDLER:
+				dprintf(fd, "  handler %p:\n", latency.handler);
+				break;
+			case HandlerLatency::KIND_CALLBACKS:
+				dprintf(fd, "  callbacks:\n");
+				break;
+			default:
+				dprintf(fd, "  other handlers:\n");
+				break;
+		}
+		latency.queueLatency.dump(fd, "    queued  ");
+		latency.dispatchTime.dump(fd, "    dispatch");
+	}
+	delete[] latencies;
+}
+
+}//namespace ThreadManager
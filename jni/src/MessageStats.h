@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBS_MESSAGESTATS_H
+#define _LIBS_MESSAGESTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Histogram.h"
+#include "Timers.h"
+
+namespace ThreadManager{
+
+class MessageHandlerInterface;
+
+// Non-zero while loopers record message latencies.
+extern int32_t gMessageStatsEnabled;
+
+/*
+ * Latencies of one handler: how long its messages waited between falling
+ * due and being dispatched, and how long dispatchMessage() took.
+ */
+struct HandlerLatency {
+	enum {
+		KIND_HANDLER = 0,	// messages for handler
+		KIND_CALLBACKS,		// messages without a target: Runnables, futures, coroutines
+		KIND_OTHER,			// handlers beyond MessageStats::MAX_HANDLERS
+	};
+
+	int32_t kind;
+	MessageHandlerInterface* handler;	// NULL unless kind is KIND_HANDLER
+	Histogram queueLatency;
+	Histogram dispatchTime;
+};
+
+/*
+ * Per handler message latency histograms.
+ *
+ * Each looper thread records into a table of its own, so recording takes no
+ * lock and shares no cache line with other loopers.  snapshot() merges the
+ * tables of every thread.  Handlers are told apart by address; a thread keeps
+ * MAX_HANDLERS of them and folds the rest into one overflow entry.  Messages
+ * without a target handler are kept apart, as callbacks.
+ */
+class MessageStats {
+public:
+	enum {
+		MAX_HANDLERS = 32,	// handlers tracked per looper thread
+	};
+
+	static inline bool isEnabled() {
+		return __builtin_expect(__atomic_load_n(&gMessageStatsEnabled, __ATOMIC_RELAXED), 0);
+	}
+
+	/**
+     * Start or stop recording.  Stopping keeps what has been recorded.
+     */
+	static void setEnabled(bool enabled);
+
+	/**
+     * Record one dispatch on the calling looper thread.  handler is NULL
+     * for a message without a target.
+     */
+	static void record(MessageHandlerInterface* handler, nsecs_t queueLatency,
+			nsecs_t dispatchTime);
+
+	/**
+     * Merge every thread's histograms for handler into out, or those of the
+     * callbacks if handler is NULL.
+     *
+     * Returns true if anything was recorded for it.
+     */
+	static bool snapshot(MessageHandlerInterface* handler, HandlerLatency* out);
+
+	/**
+     * Merge every thread's histograms into out, one entry per handler.
+     *
+     * Returns the number of entries written.  When that is max, there may
+     * be more handlers than fitted.
+     */
+	static size_t snapshot(HandlerLatency* out, size_t max);
+
+	/**
+     * Forget everything recorded so far.  Call with recording stopped.
+     */
+	static void reset();
+
+	/**
+     * Drop what was recorded for handler and free its slots, so that a
+     * handler created later at the same address starts afresh.  Called
+     * when a handler is destroyed.
+     */
+	static void forget(MessageHandlerInterface* handler);
+
+	/**
+     * Write the merged histograms of every handler to fd.
+     */
+	static void dump(int fd);
+};
+
+}//namespace ThreadManager
+
+#endif //_LIBS_MESSAGESTATS_H
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Binary message trace.
+ *
+ *  Rings are kept the way AsyncLog keeps them: linked once into a global
+ *  list, never freed, handed back when their thread exits and adopted by
+ *  the next thread that traces.  Only the owning thread writes a ring; the
+ *  exporter reads the published count and copies records out.
+ */
+
+#include "MessageTrace.h"
+#include "Timers.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int32_t gMessageTracing = 0;
+
+static const size_t DEFAULT_TRACE_RECORDS = 4096;
+
+struct TraceRecord {
+    nsecs_t     time;       // SYSTEM_TIME_FAST
+    const void* message;
+    const void* handler;
+    int32_t     tid;
+    int32_t     event;
+    int32_t     what;
+};
+
+struct TraceRing {
+    TraceRing*          next;       // all rings, linked once, never unlinked
+    volatile int32_t    owned;      // 1 while a thread records into the ring
+    int32_t             tid;        // owner, cached to keep gettid() off the path
+    uint32_t            mask;       // capacity - 1
+    volatile uint32_t   written;    // records ever written; owner only
+    TraceRecord         records[1];
+};
+
+static TraceRing* volatile gTraceRings = NULL;
+static pthread_key_t gTraceRingKey;
+static pthread_once_t gTraceRingKeyOnce = PTHREAD_ONCE_INIT;
+static volatile size_t gTraceRecords = DEFAULT_TRACE_RECORDS;
+
+static void releaseTraceRing(void* ring)
+{
+    __atomic_store_n(&((TraceRing*) ring)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static void initTraceRingKey()
+{
+    pthread_key_create(&gTraceRingKey, releaseTraceRing);
+}
+
+static TraceRing* adoptTraceRing()
+{
+    TraceRing* ring = __atomic_load_n(&gTraceRings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        int32_t expected = 0;
+        if (__atomic_load_n(&ring->owned, __ATOMIC_RELAXED) == 0
+                && __atomic_compare_exchange_n(&ring->owned, &expected, 1, false,
+                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            ring->tid = gettid();
+            return ring;
+        }
+    }
+
+    size_t records = gTraceRecords;
+    ring = (TraceRing*) calloc(1, sizeof(TraceRing) + (records - 1) * sizeof(TraceRecord));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->owned = 1;
+    ring->tid = gettid();
+    ring->mask = records - 1;
+    TraceRing* head = __atomic_load_n(&gTraceRings, __ATOMIC_RELAXED);
+    do {
+        ring->next = head;
+    } while (!__atomic_compare_exchange_n(&gTraceRings, &head, ring, true,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return ring;
+}
+
+void androidMessageTrace(int32_t event, const void* message,
+                         const void* handler, int32_t what)
+{
+    pthread_once(&gTraceRingKeyOnce, initTraceRingKey);
+    TraceRing* ring = (TraceRing*) pthread_getspecific(gTraceRingKey);
+    if (ring == NULL) {
+        ring = adoptTraceRing();
+        if (ring == NULL) {
+            return;
+        }
+        pthread_setspecific(gTraceRingKey, ring);
+    }
+
+    uint32_t n = ring->written;
+    TraceRecord* record = &ring->records[n & ring->mask];
+    record->time = systemTime(SYSTEM_TIME_FAST);
+    record->message = message;
+    record->handler = handler;
+    record->tid = ring->tid;
+    record->event = event;
+    record->what = what;
+    __atomic_store_n(&ring->written, n + 1, __ATOMIC_RELEASE);
+}
+
+void androidSetMessageTracing(int enable)
+{
+    __atomic_store_n(&gMessageTracing, enable ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+void androidSetMessageTraceBufferSize(size_t records)
+{
+    size_t size = 1;
+    while (size < records) {
+        size <<= 1;
+    }
+    gTraceRecords = size;
+}
+
+void androidResetMessageTrace(void)
+{
+    TraceRing* ring = __atomic_load_n(&gTraceRings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        __atomic_store_n(&ring->written, 0, __ATOMIC_RELEASE);
+    }
+}
+
+// Chrome trace event format; "ts" is in microseconds.
+static void exportRecord(int fd, int pid, const TraceRecord& r, bool first)
+{
+    const char* sep = first ? "\n" : ",\n";
+    double ts = r.time / 1000.0;
+
+    switch (r.event) {
+        case MESSAGE_TRACE_SEND:
+            dprintf(fd, "%s{\"name\":\"send\",\"cat\":\"message\",\"ph\":\"i\",\"s\":\"t\","
+                    "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"message\":\"%p\",\"handler\":\"%p\",\"what\":%d}}",
+                    sep, pid, r.tid, ts, r.message, r.handler, r.what);
+            // Flow arrow from the send to the dispatch of the same message.
+            dprintf(fd, ",\n{\"name\":\"message\",\"cat\":\"message\",\"ph\":\"s\","
+                    "\"id\":\"%p\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                    r.message, pid, r.tid, ts);
+            break;
+        case MESSAGE_TRACE_DISPATCH_BEGIN:
+            dprintf(fd, "%s{\"name\":\"dispatch\",\"cat\":\"message\",\"ph\":\"B\","
+                    "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"message\":\"%p\",\"handler\":\"%p\",\"what\":%d}}",
+                    sep, pid, r.tid, ts, r.message, r.handler, r.what);
+            dprintf(fd, ",\n{\"name\":\"message\",\"cat\":\"message\",\"ph\":\"f\",\"bp\":\"e\","
+                    "\"id\":\"%p\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                    r.message, pid, r.tid, ts);
+            break;
+        case MESSAGE_TRACE_DISPATCH_END:
+            dprintf(fd, "%s{\"name\":\"dispatch\",\"cat\":\"message\",\"ph\":\"E\","
+                    "\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                    sep, pid, r.tid, ts);
+            break;
+        case MESSAGE_TRACE_POLL_BEGIN:
+            dprintf(fd, "%s{\"name\":\"poll\",\"cat\":\"looper\",\"ph\":\"B\","
+                    "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"timeoutMillis\":%d}}",
+                    sep, pid, r.tid, ts, r.what);
+            break;
+        case MESSAGE_TRACE_POLL_END:
+            dprintf(fd, "%s{\"name\":\"poll\",\"cat\":\"looper\",\"ph\":\"E\","
+                    "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"events\":%d}}",
+                    sep, pid, r.tid, ts, r.what);
+            break;
+        default: {
+            const char* name = r.event == MESSAGE_TRACE_ENQUEUE ? "enqueue"
+                    : r.event == MESSAGE_TRACE_WAKE ? "wake"
+                    : r.event == MESSAGE_TRACE_DEQUEUE ? "dequeue" : "unknown";
+            dprintf(fd, "%s{\"name\":\"%s\",\"cat\":\"message\",\"ph\":\"i\",\"s\":\"t\","
+                    "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                    "\"args\":{\"message\":\"%p\",\"handler\":\"%p\",\"what\":%d}}",
+                    sep, name, pid, r.tid, ts, r.message, r.handler, r.what);
+            break;
+        }
+    }
+}
+
+size_t androidExportMessageTrace(int fd)
+{
+    int pid = getpid();
+    size_t count = 0;
+
+    dprintf(fd, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    TraceRing* ring = __atomic_load_n(&gTraceRings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        uint32_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+        uint32_t capacity = ring->mask + 1;
+        uint32_t first = written > capacity ? written - capacity : 0;
+        for (uint32_t i = first; i != written; i++) {
+            exportRecord(fd, pid, ring->records[i & ring->mask], count == 0);
+            count++;
+        }
+    }
+    dprintf(fd, "\n]}\n");
+    return count;
+}
@@ -1,124 +1,201 @@
-/*
- * Copyright (C) ThreadManager Module Project.
- * @Author chenglan@ucweb.com 
- * @Date 2014-12-30
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#ifndef _LIBS_MESSAGEHANDLER_H
-#define _LIBS_MESSAGEHANDLER_H
-
-#include "Mutex.h"
-#include "Looper.h"
-#include "Message.h"
-
-namespace ThreadManager{
-
-class MessageConsumer {//: public PollerCallback{
-public:
-	MessageConsumer();
-	virtual ~MessageConsumer();
-
-	//
-	virtual int32_t consumeMessage(Message* msg,int32_t when
-					 , MessageHandlerInterface* handler) const;
-
-	//
-	virtual int handleEvent(int fd, int events, void* data); 
-private:
-	MessageHandlerInterface* mHandler;
-};//MessageConsumer
-
-class MessageHandlerPolicyInterface{
-protected:
-    MessageHandlerPolicyInterface() { }
-    virtual ~MessageHandlerPolicyInterface() { }
-
-public:
-     
-    virtual void notifyMessage() = 0;
-};
-
-
-class MessageHandlerInterface{
-public:
-	MessageHandlerInterface(){}
-	virtual ~MessageHandlerInterface(){}
-
-	/**
-     * Subclasses must implement this to receive messages.
-     */
-	virtual bool handleMessage(const Message* const mMessage) const =0;
-
-	/**
-     * Pushes a message onto the end of the message queue after all pending messages
-     * before the current time. It will be received in #handleMessage,
-     * in the thread attached to this handler.
-     *  
-     * Returns true if the message was successfully placed in to the 
-     * message queue.  Returns false on failure, usually because the
-     * looper processing the message queue is exiting.
-     */
-	virtual bool sendMessage(const Message& mMessage,int32_t when)=0;
-
-	/**
-     * Dispatch the message to Message Consumer.
-     * Return true on dipatch success.
-     */
-	virtual bool dispatchMessage(Message* mMessage)=0;
-
-	/**
-     * Obtain a Message.
-     * Return message object.
-     */
-	virtual Message* obtainMessage()=0;
-};//class MessageHandlerInterface
-
-class MessagePublisher;
-
-class MessageHandler : public MessageHandlerInterface{
-public:
-	
-	virtual bool handleMessage(const Message* const mMessage)const;
-	
-	virtual bool sendMessage(const Message& mMessage,int32_t when);
-	
-	virtual bool dispatchMessage(Message* mMessage);
-	
-	virtual Message* obtainMessage();
-	
-	class Callback {
-	public:
-		virtual ~Callback(){}
-		virtual bool enqueueMessage(const Message& msg,long when)=0;
-		virtual void removeMessages(MessageHandlerInterface* mHandler,Message& msg)=0;
-	};//Callback
-
-	MessageHandler();
-	
-	MessageHandler(LooperInterface* looper,MessageHandler::Callback* queue
-					,MessageHandlerPolicyInterface* policy);
-	virtual ~MessageHandler();
-
-private:
-	//The controller for message interact.
-	LooperInterface* mLooper;
-
-	//The Message Consumer.
-	MessageConsumer mConsumer;
-
-	//The Message Publisher
-	MessagePublisher* mPublisher;
-
-	MessageHandlerPolicyInterface* mPolicy;
-	
-};//class Messagehandler
-
-}//namespace ThreadManager
-
-#endif //_LIBS_MESSAGEHANDLER_H
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBS_MESSAGEHANDLER_H
+#define _LIBS_MESSAGEHANDLER_H
+
+#include "Mutex.h"
+#include "Looper.h"
+#include "Message.h"
+
+namespace ThreadManager{
+
+class MessageConsumer {//: public PollerCallback{
+public:
+	MessageConsumer();
+	virtual ~MessageConsumer();
+
+	//
+	virtual int32_t consumeMessage(Message* msg,int32_t when
+					 , MessageHandlerInterface* handler) const;
+
+	//
+	virtual int handleEvent(int fd, int events, void* data); 
+private:
+	MessageHandlerInterface* mHandler;
+};//MessageConsumer
+
+class MessageHandlerPolicyInterface{
+protected:
+    MessageHandlerPolicyInterface() { }
+    virtual ~MessageHandlerPolicyInterface() { }
+
+public:
+     
+    /**
+     * Called on the looper thread for each message the handler takes.
+     */
+    virtual void notifyMessage(const Message* msg) = 0;
+};
+
+
+class MessageHandlerInterface{
+public:
+	MessageHandlerInterface(){}
+	virtual ~MessageHandlerInterface(){}
+
+	/**
+     * Subclasses must implement this to receive messages.
+     */
+	virtual bool handleMessage(const Message* const mMessage) const =0;
+
+	/**
+     * Pushes a message onto the end of the message queue after all pending messages
+     * before the current time. It will be received in #handleMessage,
+     * in the thread attached to this handler.
+     *  
+     * Returns true if the message was successfully placed in to the 
+     * message queue.  Returns false on failure, usually because the
+     * looper processing the message queue is exiting.
+     */
+	virtual bool sendMessage(const Message& mMessage,nsecs_t when)=0;
+
+	/**
+     * Same as sendMessage(), delivered delayMillis from now.
+     */
+	virtual bool sendMessageDelayed(const Message& mMessage,int64_t delayMillis)=0;
+
+	/**
+     * Remove the messages with the given what still in the queue.
+     */
+	virtual void removeMessages(int32_t what)=0;
+
+	/**
+     * Send a message now and block until the handler answers it with
+     * Message::reply(), or until timeout (ns, negative waits forever).
+     *
+     * Returns NO_ERROR with the reply in *result; TIMED_OUT; DEAD_OBJECT
+     * if it was dispatched or removed without a reply; WOULD_BLOCK if
+     * called on the handler's own looper thread, which could never answer.
+     * On WOULD_BLOCK or UNKNOWN_ERROR the message was not sent and is
+     * still the caller's.
+     */
+	virtual status_t sendMessageAndWait(Message& mMessage,nsecs_t timeout,int32_t* result)=0;
+
+	/**
+     * Dispatch the message to Message Consumer.
+     * Return true on dipatch success.
+     */
+	virtual bool dispatchMessage(Message* mMessage)=0;
+
+	/**
+     * Obtain a Message.
+     * Return message object.
+     */
+	virtual Message* obtainMessage()=0;
+
+	/**
+     * Obtain a Message with what and arguments set.
+     * Return message object.
+     */
+	virtual Message* obtainMessage(int32_t what,int32_t arg1,int32_t arg2)=0;
+};//class MessageHandlerInterface
+
+class MessagePublisher;
+
+class MessageHandler : public MessageHandlerInterface{
+public:
+	
+	virtual bool handleMessage(const Message* const mMessage)const;
+	
+	virtual bool sendMessage(const Message& mMessage,nsecs_t when);
+
+	virtual bool sendMessageDelayed(const Message& mMessage,int64_t delayMillis);
+
+	virtual void removeMessages(int32_t what);
+
+	virtual status_t sendMessageAndWait(Message& mMessage,nsecs_t timeout,int32_t* result);
+	
+	virtual bool dispatchMessage(Message* mMessage);
+	
+	virtual Message* obtainMessage();
+
+	virtual Message* obtainMessage(int32_t what,int32_t arg1,int32_t arg2);
+
+	/**
+     * Run fn on this handler's looper, as soon as possible or delayMillis
+     * from now.  fn is moved into the message itself (see
+     * Message::CALLABLE_CAPACITY) and called by the looper directly,
+     * bypassing handleMessage().
+     *
+     * Returns false if the looper takes no more messages.
+     */
+	template <typename F>
+	bool post(F&& fn){
+		return postAtTime(std::forward<F>(fn), systemTime(SYSTEM_TIME_MONOTONIC));
+	}
+
+	template <typename F>
+	bool postDelayed(F&& fn,int64_t delayMillis){
+		if (delayMillis < 0) {
+			delayMillis = 0;
+		}
+		return postAtTime(std::forward<F>(fn),
+				systemTime(SYSTEM_TIME_MONOTONIC) + ms2ns(delayMillis));
+	}
+
+	//when is SYSTEM_TIME_MONOTONIC.
+	template <typename F>
+	bool postAtTime(F&& fn,nsecs_t when){
+		Message* msg = obtainMessage();
+		if (NULL == msg) {
+			return false;
+		}
+		msg->setCallable(std::forward<F>(fn));
+		if (!sendMessage(*msg, when)) {
+			msg->recycle();
+			return false;
+		}
+		return true;
+	}
+	
+	class Callback {
+	public:
+		virtual ~Callback(){}
+		//when is SYSTEM_TIME_MONOTONIC; 0 puts the message at the front.
+		virtual bool enqueueMessage(const Message& msg,nsecs_t when)=0;
+		virtual void removeMessages(MessageHandlerInterface* handler,int32_t what)=0;
+	};//Callback
+
+	MessageHandler();
+	
+	MessageHandler(LooperInterface* looper,MessageHandler::Callback* queue
+					,MessageHandlerPolicyInterface* policy);
+	virtual ~MessageHandler();
+
+private:
+	//The controller for message interact.
+	LooperInterface* mLooper;
+
+	//The Message Consumer.
+	MessageConsumer mConsumer;
+
+	//The Message Publisher
+	MessagePublisher* mPublisher;
+
+	MessageHandlerPolicyInterface* mPolicy;
+	
+};//class Messagehandler
+
+}//namespace ThreadManager
+
+#endif //_LIBS_MESSAGEHANDLER_H
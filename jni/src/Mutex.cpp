@@ -18,8 +18,58 @@
 #include "Mutex.h"
 #include "logging.h"
 #include <errno.h>
+#include <string.h>
 
 namespace ThreadManager{
+
+#if defined(HAVE_FUTEX_MUTEX)
+
+// Upper bound for the adaptive spin, in cpuRelax() iterations.
+static const int32_t MAX_ADAPTIVE_SPINS = 100;
+
+/*******************************************************************************
+**
+** Function:        lockContended
+**
+** Description:     Spin for a while, then sleep on the futex until the
+**                  mutex is released.  The spin budget follows how long
+**                  recent acquisitions had to spin, as glibc's adaptive
+**                  mutexes do.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void Mutex::lockContended()
+{
+    int32_t limit = __atomic_load_n(&mSpinLimit, __ATOMIC_RELAXED);
+    int32_t maxSpins = limit * 2 + 10;
+    if (maxSpins > MAX_ADAPTIVE_SPINS) {
+        maxSpins = MAX_ADAPTIVE_SPINS;
+    }
+
+    int32_t spins = 0;
+    while (spins < maxSpins) {
+        if (__atomic_load_n(&mState, __ATOMIC_RELAXED) == UNLOCKED) {
+            int32_t expected = UNLOCKED;
+            if (__atomic_compare_exchange_n(&mState, &expected, LOCKED, false,
+                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                __atomic_store_n(&mSpinLimit, limit + (spins - limit) / 8,
+                        __ATOMIC_RELAXED);
+                return;
+            }
+        }
+        cpuRelax();
+        spins++;
+    }
+    __atomic_store_n(&mSpinLimit, limit + (spins - limit) / 8, __ATOMIC_RELAXED);
+
+    // Mark the mutex contended so that unlock() wakes us, then sleep.
+    while (__atomic_exchange_n(&mState, CONTENDED, __ATOMIC_ACQUIRE) != UNLOCKED) {
+        futexWait(&mState, CONTENDED, NULL);
+    }
+}
+
+#else // HAVE_FUTEX_MUTEX
 /*******************************************************************************
 **
 ** Function:        Mutex
@@ -30,6 +80,29 @@ namespace ThreadManager{
 **
 *******************************************************************************/
 Mutex::Mutex()
+    : mName(NULL), mProfile(NULL), mOwner(0)
+{
+    memset (&mMutex, 0, sizeof(mMutex));
+    int res = pthread_mutex_init (&mMutex, NULL);
+    if (res != 0)
+    {
+        ALOGE ("Mutex::Mutex: fail init; error=0x%X", res);
+    }
+}
+
+
+/*******************************************************************************
+**
+** Function:        Mutex
+**
+** Description:     Initialize member variables.  The name labels the
+**                  mutex in contention dumps; it is not copied.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+Mutex::Mutex(const char* name)
+    : mName(name), mProfile(NULL), mOwner(0)
 {
     memset (&mMutex, 0, sizeof(mMutex));
     int res = pthread_mutex_init (&mMutex, NULL);
@@ -51,6 +124,10 @@ Mutex::Mutex()
 *******************************************************************************/
 Mutex::~Mutex()
 {
+    if (mProfile != NULL)
+    {
+        releaseProfile ();
+    }
     int res = pthread_mutex_destroy (&mMutex);
     if (res != 0)
     {
@@ -70,6 +147,11 @@ Mutex::~Mutex()
 *******************************************************************************/
 void Mutex::lock()
 {
+    if (__builtin_expect(__atomic_load_n(&gMutexProfiling, __ATOMIC_RELAXED), 0))
+    {
+        lockProfiled (__builtin_return_address(0));
+        return;
+    }
     int res = pthread_mutex_lock (&mMutex);
     if (res != 0)
     {
@@ -131,5 +213,7 @@ pthread_mutex_t* Mutex::nativeHandle()
     return &mMutex;
 }
 
+#endif // HAVE_FUTEX_MUTEX
+
 }
 
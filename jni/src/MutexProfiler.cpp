@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ *  Opt-in contention profiler for Mutex.
+ *
+ *  Each mutex that is ever contended while profiling gets a MutexProfile.
+ *  Samples are recorded by the thread that just acquired the mutex, so the
+ *  mutex itself serialises updates to its profile; only dump and reset read
+ *  it from outside, and they accept slightly stale numbers.
+ */
+
+#include "Mutex.h"
+#include "Timers.h"
+#include "logging.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace ThreadManager{
+
+int32_t gMutexProfiling = 0;
+
+enum {
+    WAIT_BUCKETS    = 32,   // bucket i counts waits in [2^i, 2^(i+1)) ns
+    MAX_SITES       = 8,    // call sites kept per mutex
+    MAX_PROFILES    = 1024, // mutexes tracked at most
+    NAME_LENGTH     = 32,
+};
+
+struct MutexSite {
+    void*       pc;
+    uint32_t    count;
+    uint64_t    waitNs;
+    pid_t       lastHolder;
+};
+
+struct MutexProfile {
+    MutexProfile*   next;
+    const void*     mutex;              // NULL once the mutex is destroyed
+    char            name[NAME_LENGTH];
+    uint32_t        contentions;
+    uint64_t        totalWaitNs;
+    uint64_t        maxWaitNs;
+    pid_t           maxWaitHolder;
+    uint32_t        otherSites;         // samples that found MAX_SITES full
+    uint32_t        buckets[WAIT_BUCKETS];
+    MutexSite       sites[MAX_SITES];
+};
+
+// Profiles are pushed lock-free and never freed, so dump can walk the list
+// while mutexes come and go.
+static MutexProfile* volatile gProfiles = NULL;
+static volatile int32_t gProfileCount = 0;
+static volatile int32_t gUntrackedWaits = 0;
+
+static int waitBucket(uint64_t ns)
+{
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    return bucket < WAIT_BUCKETS ? bucket : WAIT_BUCKETS - 1;
+}
+
+static MutexProfile* newProfile(const void* mutex, const char* name)
+{
+    if (__atomic_add_fetch(&gProfileCount, 1, __ATOMIC_RELAXED) > MAX_PROFILES) {
+        __atomic_sub_fetch(&gProfileCount, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&gUntrackedWaits, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    MutexProfile* profile = (MutexProfile*) calloc(1, sizeof(MutexProfile));
+    if (profile == NULL) {
+        __atomic_sub_fetch(&gProfileCount, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    profile->mutex = mutex;
+    if (name != NULL) {
+        strncpy(profile->name, name, NAME_LENGTH - 1);
+    } else {
+        snprintf(profile->name, NAME_LENGTH, "mutex@%p", mutex);
+    }
+
+    MutexProfile* head = __atomic_load_n(&gProfiles, __ATOMIC_RELAXED);
+    do {
+        profile->next = head;
+    } while (!__atomic_compare_exchange_n(&gProfiles, &head, profile, true,
+            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return profile;
+}
+
+static void recordContention(MutexProfile* profile, uint64_t waitNs,
+        pid_t holder, void* pc)
+{
+    profile->contentions++;
+    profile->totalWaitNs += waitNs;
+    if (waitNs > profile->maxWaitNs) {
+        profile->maxWaitNs = waitNs;
+        profile->maxWaitHolder = holder;
+    }
+    profile->buckets[waitBucket(waitNs)]++;
+
+    for (int i = 0; i < MAX_SITES; i++) {
+        MutexSite& site = profile->sites[i];
+        if (site.pc == NULL) {
+            site.pc = pc;
+        } else if (site.pc != pc) {
+            continue;
+        }
+        site.count++;
+        site.waitNs += waitNs;
+        site.lastHolder = holder;
+        return;
+    }
+    profile->otherSites++;
+}
+
+
+/*******************************************************************************
+**
+** Function:        lockProfiled
+**
+** Description:     lock() while the profiler is on: try-lock first, and
+**                  on contention time the wait and record it.  site is
+**                  the caller's return address, or NULL to take our own.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void Mutex::lockProfiled(void* site)
+{
+    if (site == NULL)
+    {
+        site = __builtin_return_address(0);
+    }
+    if (tryLock())
+    {
+        mOwner = gettid();
+        return;
+    }
+
+    pid_t holder = mOwner;
+    uint64_t start = systemTime(SYSTEM_TIME_FAST);
+#if defined(HAVE_FUTEX_MUTEX)
+    lockContended ();
+#else
+    int res = pthread_mutex_lock (&mMutex);
+    if (res != 0)
+    {
+        ALOGE ("Mutex::lock: fail lock; error=0x%X", res);
+    }
+#endif
+    uint64_t waited = systemTime(SYSTEM_TIME_FAST) - start;
+    mOwner = gettid();
+
+    // We hold the mutex, so nobody else touches mProfile now.
+    if (mProfile == NULL)
+    {
+        mProfile = newProfile(this, mName);
+        if (mProfile == NULL)
+        {
+            return;
+        }
+    }
+    recordContention(mProfile, waited, holder, site);
+}
+
+
+/*******************************************************************************
+**
+** Function:        releaseProfile
+**
+** Description:     Detach the profile of a mutex being destroyed.  The
+**                  statistics stay around for dumpContention.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void Mutex::releaseProfile()
+{
+    __atomic_store_n(&mProfile->mutex, (const void*) NULL, __ATOMIC_RELAXED);
+    mProfile = NULL;
+}
+
+
+/*******************************************************************************
+**
+** Function:        setContentionProfiling
+**
+** Description:     Turn the contention profiler on or off for all mutexes.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void Mutex::setContentionProfiling(bool enable)
+{
+    __atomic_store_n(&gMutexProfiling, enable ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+
+/*******************************************************************************
+**
+** Function:        resetContentionProfile
+**
+** Description:     Clear the statistics gathered so far.  Samples recorded
+**                  concurrently may be lost or half cleared.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void Mutex::resetContentionProfile()
+{
+    MutexProfile* profile = __atomic_load_n(&gProfiles, __ATOMIC_ACQUIRE);
+    for (; profile != NULL; profile = profile->next)
+    {
+        profile->contentions = 0;
+        profile->totalWaitNs = 0;
+        profile->maxWaitNs = 0;
+        profile->maxWaitHolder = 0;
+        profile->otherSites = 0;
+        memset (profile->buckets, 0, sizeof(profile->buckets));
+        memset (profile->sites, 0, sizeof(profile->sites));
+    }
+    __atomic_store_n(&gUntrackedWaits, 0, __ATOMIC_RELAXED);
+}
+
+
+static void dumpSite(int fd, const MutexSite& site)
+{
+    char wait[32];
+    formatDuration(wait, sizeof(wait), site.waitNs);
+
+    Dl_info info;
+    if (dladdr(site.pc, &info) && info.dli_sname != NULL) {
+        dprintf(fd, "      %p %s+0x%zx: %u waits, %s, last holder tid %d\n",
+                site.pc, info.dli_sname,
+                (size_t) ((const char*) site.pc - (const char*) info.dli_saddr),
+                site.count, wait, site.lastHolder);
+    } else {
+        dprintf(fd, "      %p: %u waits, %s, last holder tid %d\n",
+                site.pc, site.count, wait, site.lastHolder);
+    }
+}
+
+static void dumpProfile(int fd, size_t rank, const MutexProfile* profile)
+{
+    char total[32], max[32], avg[32];
+    formatDuration(total, sizeof(total), profile->totalWaitNs);
+    formatDuration(max, sizeof(max), profile->maxWaitNs);
+    formatDuration(avg, sizeof(avg), profile->totalWaitNs / profile->contentions);
+
+    dprintf(fd, "  #%zu %s%s: %u contended locks, total %s, avg %s, "
+            "max %s (holder tid %d)\n",
+            rank, profile->name, profile->mutex ? "" : " (destroyed)",
+            profile->contentions, total, avg, max, profile->maxWaitHolder);
+
+    dprintf(fd, "    wait histogram:\n");
+    for (int i = 0; i < WAIT_BUCKETS; i++) {
+        if (profile->buckets[i] == 0) {
+            continue;
+        }
+        char bound[32];
+        if (i == WAIT_BUCKETS - 1) {
+            formatDuration(bound, sizeof(bound), 1ULL << i);
+            dprintf(fd, "      >= %-9s %u\n", bound, profile->buckets[i]);
+        } else {
+            formatDuration(bound, sizeof(bound), 1ULL << (i + 1));
+            dprintf(fd, "      <  %-9s %u\n", bound, profile->buckets[i]);
+        }
+    }
+
+    // Hottest call sites first.
+    const MutexSite* sites[MAX_SITES];
+    int count = 0;
+    for (int i = 0; i < MAX_SITES && profile->sites[i].pc != NULL; i++) {
+        const MutexSite* site = &profile->sites[i];
+        int j = count++;
+        for (; j > 0 && sites[j - 1]->waitNs < site->waitNs; j--) {
+            sites[j] = sites[j - 1];
+        }
+        sites[j] = site;
+    }
+    dprintf(fd, "    call sites:\n");
+    for (int i = 0; i < count; i++) {
+        dumpSite(fd, *sites[i]);
+    }
+    if (profile->otherSites) {
+        dprintf(fd, "      (%u waits from other sites)\n", profile->otherSites);
+    }
+}
+
+
+/*******************************************************************************
+**
+** Function:        dumpContention
+**
+** Description:     Write the contended mutexes to fd, most total wait
+**                  first.  maxLocks limits the output, 0 means all.
+**
+** Returns:         None.
+**
+*******************************************************************************/
+void Mutex::dumpContention(int fd, size_t maxLocks)
+{
+    size_t capacity = __atomic_load_n(&gProfileCount, __ATOMIC_RELAXED);
+    const MutexProfile** ranked = (const MutexProfile**)
+            malloc((capacity ? capacity : 1) * sizeof(MutexProfile*));
+    if (ranked == NULL)
+    {
+        ALOGE ("Mutex::dumpContention: out of memory");
+        return;
+    }
+
+    size_t count = 0;
+    const MutexProfile* profile = __atomic_load_n(&gProfiles, __ATOMIC_ACQUIRE);
+    for (; profile != NULL && count < capacity; profile = profile->next)
+    {
+        if (profile->contentions == 0)
+        {
+            continue;
+        }
+        size_t j = count++;
+        for (; j > 0 && ranked[j - 1]->totalWaitNs < profile->totalWaitNs; j--)
+        {
+            ranked[j] = ranked[j - 1];
+        }
+        ranked[j] = profile;
+    }
+
+    dprintf (fd, "Mutex contention (%s, %zu contended mutexes, by total wait):\n",
+            __atomic_load_n(&gMutexProfiling, __ATOMIC_RELAXED) ? "on" : "off",
+            count);
+    if (maxLocks == 0 || maxLocks > count)
+    {
+        maxLocks = count;
+    }
+    for (size_t i = 0; i < maxLocks; i++)
+    {
+        dumpProfile (fd, i + 1, ranked[i]);
+    }
+    int32_t dropped = __atomic_load_n(&gUntrackedWaits, __ATOMIC_RELAXED);
+    if (dropped)
+    {
+        dprintf (fd, "  (%d waits on mutexes beyond the tracking limit)\n", dropped);
+    }
+    free (ranked);
+}
+
+}
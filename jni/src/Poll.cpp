@@ -12,7 +12,7 @@
 
 
 // Debugs poll and wake interactions.
-#define DEBUG_POLL_AND_WAKE 1
+#define DEBUG_POLL_AND_WAKE 0
 
 // Debugs callback registration and invocation.
 #define DEBUG_CALLBACKS 0
@@ -20,6 +20,9 @@
 #include "logging.h"
 #include "Poll.h"
 #include "Timers.h"
+#include "AndroidThreads.h"
+#include "MessageTrace.h"
+#include "Trace.h"
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -70,46 +73,37 @@ static pthread_key_t gTLSKey = 0;
 
 Poll::Poll(bool allowNonCallbacks) :
         mAllowNonCallbacks(allowNonCallbacks), mSendingMessage(false),
+        mRequestCount(0), mNextRequestSeq(0),
         mResponseIndex(0), mNextMessageUptime(LLONG_MAX) {
     int wakeFds[2];
     int result = pipe(wakeFds);
 	
-#if DEBUG_POLL_AND_WAKE
 	LOG_IF_ERRNO(result!=0,"Could not create wake pipe.  errno=%d", errno);
-#endif
 
     mWakeReadPipeFd = wakeFds[0];
     mWakeWritePipeFd = wakeFds[1];
 
     result = fcntl(mWakeReadPipeFd, F_SETFL, O_NONBLOCK);
 	
-#if DEBUG_POLL_AND_WAKE
 	LOG_IF_ERRNO(result!=0,"Could not make wake read pipe non-blocking.  errno=%d",
             errno);
-#endif
 
 
     result = fcntl(mWakeWritePipeFd, F_SETFL, O_NONBLOCK);
-#if DEBUG_POLL_AND_WAKE
 	LOG_IF_ERRNO(result!=0,"Could not make wake write pipe non-blocking.  errno=%d",
             errno);
-#endif
 
     // Allocate the epoll instance and register the wake pipe.
     mEpollFd = epoll_create(EPOLL_SIZE_HINT);
-#if DEBUG_POLL_AND_WAKE
-	LOG_IF_ERRNO(result!=0,"Could not create epoll instance.  errno=%d mEpollFd=%d", errno,mEpollFd);
-#endif
+	LOG_IF_ERRNO(mEpollFd < 0,"Could not create epoll instance.  errno=%d mEpollFd=%d", errno,mEpollFd);
 
     struct epoll_event eventItem;
     memset(& eventItem, 0, sizeof(epoll_event)); // zero out unused members of data field union
     eventItem.events = EPOLLIN;
     eventItem.data.fd = mWakeReadPipeFd;
     result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeReadPipeFd, & eventItem);
-#if DEBUG_POLL_AND_WAKE
 	LOG_IF_ERRNO(result!=0,"Could not add wake read pipe to epoll instance.  errno=%d",
             errno);
-#endif
 }
 
 Poll::~Poll() {
@@ -120,9 +114,14 @@ Poll::~Poll() {
 
 void Poll::initTLSKey() {
     int result = pthread_key_create(& gTLSKey, threadDestructor);
-#if DEBUG_POLL_AND_WAKE
 	LOG_IF_ERRNO(result!=0,"Could not allocate TLS key. The value of result = %d",result);
-#endif
+    androidAddThreadRecycleHook(threadRecycled);
+}
+
+void Poll::threadRecycled() {
+    // The thread is parked for reuse rather than exiting; the poller belongs
+    // to whoever created it, so only forget it.
+    pthread_setspecific(gTLSKey, NULL);
 }
 
 void Poll::threadDestructor(void *st) {
@@ -140,9 +139,7 @@ void Poll::setForThread(const Poll& poller) {
 
 Poll* Poll::getForThread() {
     int result = pthread_once(& gTLSOnce, initTLSKey);
-#if DEBUG_POLL_AND_WAKE
 	LOG_IF_ERRNO(result!=0,"pthread_once failed. The value of result = %d",result);
-#endif
     return (Poll*)pthread_getspecific(gTLSKey);
 }
 
@@ -165,14 +162,9 @@ bool Poll::getAllowNonCallbacks() const {
 }
 
 int Poll::pollOnce(int timeoutMillis, int* outFd, int* outEvents, void** outData) {
-    int result = 0;
-	
-    for (;;) {
-       result = pollInner(timeoutMillis);
-	   if(ALOOPER_POLL_WAKE == result){
-	   		break;
-	   }
-    }
+    // Returns on a wake and on timeout alike; the caller looks at its queue
+    // either way, so it must not be held here until a wake.
+    return pollInner(timeoutMillis);
 }
 
 int Poll::pollInner(int timeoutMillis) {
@@ -194,11 +186,19 @@ int Poll::pollInner(int timeoutMillis) {
     int result = ALOOPER_POLL_WAKE;
 
     struct epoll_event eventItems[EPOLL_MAX_EVENTS];
+    Response responses[EPOLL_MAX_EVENTS];
+    int responseCount = 0;
 #if DEBUG_POLL_AND_WAKE
     ALOGD("1 %p ~ pollOnce - waiting: timeoutMillis=%d", this, timeoutMillis);
 #endif
 
-    int eventCount = epoll_wait(mEpollFd, eventItems, EPOLL_MAX_EVENTS, timeoutMillis);
+    int eventCount;
+    {
+        ATRACE_NAME("Poll::wait");
+        MESSAGE_TRACE(MESSAGE_TRACE_POLL_BEGIN, NULL, this, timeoutMillis);
+        eventCount = epoll_wait(mEpollFd, eventItems, EPOLL_MAX_EVENTS, timeoutMillis);
+        MESSAGE_TRACE(MESSAGE_TRACE_POLL_END, NULL, this, eventCount);
+    }
 #if DEBUG_POLL_AND_WAKE
 	ALOGD("2 %p ~ pollOnce - waiting: timeoutMillis=%d", this, timeoutMillis);
 #endif
@@ -241,19 +241,44 @@ int Poll::pollInner(int timeoutMillis) {
                 ALOGW("Ignoring unexpected epoll events 0x%x on wake read pipe.", epollEvents);
             }
         } else {
-          	ALOGW("Another read fd for epoll wait!");
+            ssize_t requestIndex = indexOfRequest(fd);
+            if (requestIndex >= 0) {
+                int events = 0;
+                if (epollEvents & EPOLLIN) events |= ALOOPER_EVENT_INPUT;
+                if (epollEvents & EPOLLOUT) events |= ALOOPER_EVENT_OUTPUT;
+                if (epollEvents & EPOLLERR) events |= ALOOPER_EVENT_ERROR;
+                if (epollEvents & EPOLLHUP) events |= ALOOPER_EVENT_HANGUP;
+                responses[responseCount].events = events;
+                responses[responseCount].request = mRequests[requestIndex];
+                responseCount++;
+            } else {
+                ALOGW("Ignoring unexpected epoll events 0x%x on fd %d that is "
+                        "no longer registered.", epollEvents, fd);
+            }
         }
     }
 Done: ;
 
     // Invoke pending message callbacks.
     mNextMessageUptime = LLONG_MAX;
-	ALOGI("FUNCTION=%s line=%d",__FUNCTION__,__LINE__);
+	ALOGV("FUNCTION=%s line=%d",__FUNCTION__,__LINE__);
     // Release lock.
     mLock.unlock();
 
-    // Invoke all response callbacks.
-    // Wait for a moment. HAHA
+    // Invoke all response callbacks, without the lock so they may add and
+    // remove file descriptors.
+    for (int i = 0; i < responseCount; i++) {
+        Response& response = responses[i];
+        if (response.request.ident == ALOOPER_POLL_CALLBACK) {
+            int fd = response.request.fd;
+            int callbackResult = response.request.callback->handleEvent(fd,
+                    response.events, response.request.data);
+            if (callbackResult == 0) {
+                removeFd(fd, response.request.seq);
+            }
+            result = ALOOPER_POLL_CALLBACK;
+        }
+    }
     return result;
 }
 
@@ -287,6 +312,7 @@ void Poll::wake() {
 #if DEBUG_POLL_AND_WAKE
     ALOGD("%p ~ wake", this);
 #endif
+    MESSAGE_TRACE(MESSAGE_TRACE_WAKE, NULL, this, 0);
 
     ssize_t nWrite;
     do {
@@ -344,37 +370,64 @@ int Poll::addFd(int fd, int ident, int events, const PollerCallback* callback, v
     { // acquire lock
         AutoMutex _l(mLock);
 
+        Request request;
+        request.fd = fd;
+        request.ident = ident;
+        request.seq = mNextRequestSeq++;
+        request.callback = const_cast<PollerCallback*>(callback);
+        request.data = data;
+
         struct epoll_event eventItem;
         memset(& eventItem, 0, sizeof(epoll_event)); // zero out unused members of data field union
         eventItem.events = epollEvents;
         eventItem.data.fd = fd;
 
-        ssize_t requestIndex = -1;
+        ssize_t requestIndex = indexOfRequest(fd);
         if (requestIndex < 0) {
+            if (mRequestCount == MAX_REQUESTS) {
+                ALOGE("Can't add fd %d, %d are registered already", fd, MAX_REQUESTS);
+                return -1;
+            }
             int epollResult = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, & eventItem);
             if (epollResult < 0) {
                 ALOGE("Error adding epoll events for fd %d, errno=%d", fd, errno);
                 return -1;
             }
+            mRequests[mRequestCount++] = request;
         } else {
             int epollResult = epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, & eventItem);
             if (epollResult < 0) {
                 ALOGE("Error modifying epoll events for fd %d, errno=%d", fd, errno);
                 return -1;
             }
+            mRequests[requestIndex] = request;
         }
     } // release lock
     return 1;
 }
 
 int Poll::removeFd(int fd) {
+    return removeFd(fd, -1);
+}
+
+int Poll::removeFd(int fd, int seq) {
 #if DEBUG_CALLBACKS
-    ALOGD("%p ~ removeFd - fd=%d", this, fd);
+    ALOGD("%p ~ removeFd - fd=%d, seq=%d", this, fd, seq);
 #endif
 
     { // acquire lock
         AutoMutex _l(mLock);
 
+        ssize_t requestIndex = indexOfRequest(fd);
+        if (requestIndex < 0) {
+            return 0;
+        }
+        // The fd was registered again since; that registration stays.
+        if (seq != -1 && mRequests[requestIndex].seq != seq) {
+            return 0;
+        }
+        mRequests[requestIndex] = mRequests[--mRequestCount];
+
         int epollResult = epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
         if (epollResult < 0) {
             ALOGE("Error removing epoll events for fd %d, errno=%d", fd, errno);
@@ -385,6 +438,15 @@ int Poll::removeFd(int fd) {
     return 1;
 }
 
+ssize_t Poll::indexOfRequest(int fd) const {
+    for (size_t i = 0; i < mRequestCount; i++) {
+        if (mRequests[i].fd == fd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 void Poll::sendMessage(const MessageHandler& handler, const Message& message) {
     nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
     sendMessageAtTime(now, handler, message);
@@ -329,6 +329,28 @@ private:
 
     int mEpollFd; // immutable
 
+    struct Request {
+        int fd;
+        int ident;
+        int seq;
+        PollerCallback* callback;
+        void* data;
+    };
+
+    struct Response {
+        int events;
+        Request request;
+    };
+
+    enum {
+        MAX_REQUESTS = 16
+    };
+
+    // Registered file descriptors, in no particular order.
+    Request mRequests[MAX_REQUESTS]; // guarded by mLock
+    size_t mRequestCount; // guarded by mLock
+    int mNextRequestSeq; // guarded by mLock
+
     // This state is only used privately by pollOnce and does not require a lock since
     // it runs on a single thread.
     //std::vetor<Response> mResponses;
@@ -337,10 +359,13 @@ private:
 
     int pollInner(int timeoutMillis);
     void awoken();
-    //void pushResponse(int events, const Request& request);
+    ssize_t indexOfRequest(int fd) const; // requires mLock
+    // Removes fd only if it is still the registration seq refers to (-1: any).
+    int removeFd(int fd, int seq);
 
     static void initTLSKey();
     static void threadDestructor(void *st);
+    static void threadRecycled();
 };
 
 } // namespace ThreadManager
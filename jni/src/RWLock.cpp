@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "RWLock.h"
+
+#include <limits.h>
+
+namespace ThreadManager {
+
+// How many times a reader retries before sleeping behind a writer.
+static const int READ_SPINS = 50;
+
+RWLock::RWLock() : mState(0), mWriters(0) {
+}
+
+RWLock::~RWLock() {
+}
+
+void RWLock::readLockContended() {
+    int spins = 0;
+    for (;;) {
+        int32_t s = __atomic_load_n(&mState, __ATOMIC_RELAXED);
+        if (!(s & WRITER)) {
+            if (__atomic_compare_exchange_n(&mState, &s, s + 1, false,
+                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            // lost against another reader; retry straight away
+            continue;
+        }
+        if (spins < READ_SPINS) {
+            spins++;
+            cpuRelax();
+            continue;
+        }
+        futexWait(&mState, s, NULL);
+    }
+}
+
+status_t RWLock::tryReadLock() {
+    int32_t s = __atomic_load_n(&mState, __ATOMIC_RELAXED);
+    while (!(s & WRITER)) {
+        if (__atomic_compare_exchange_n(&mState, &s, s + 1, false,
+                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return NO_ERROR;
+        }
+    }
+    return WOULD_BLOCK;
+}
+
+void RWLock::readUnlock() {
+    int32_t s = __atomic_sub_fetch(&mState, 1, __ATOMIC_RELEASE);
+    if (s == WRITER) {
+        // Last reader out with a writer waiting.  Readers sleep on the same
+        // word, so wake everybody; they go back to sleep behind the writer.
+        futexWake(&mState, INT_MAX);
+    }
+}
+
+status_t RWLock::writeLock() {
+    // Count ourselves first so that a writer unlocking in the meantime hands
+    // the lock over instead of letting readers in.
+    __atomic_add_fetch(&mWriters, 1, __ATOMIC_RELAXED);
+    mWriterLock.lock();
+
+    int32_t s = __atomic_or_fetch(&mState, WRITER, __ATOMIC_ACQUIRE);
+    while (s & READERS_MASK) {
+        futexWait(&mState, s, NULL);
+        s = __atomic_load_n(&mState, __ATOMIC_ACQUIRE);
+    }
+    return NO_ERROR;
+}
+
+status_t RWLock::tryWriteLock() {
+    if (!mWriterLock.tryLock()) {
+        return WOULD_BLOCK;
+    }
+    int32_t s = __atomic_load_n(&mState, __ATOMIC_RELAXED);
+    do {
+        if (s & READERS_MASK) {
+            mWriterLock.unlock();
+            return WOULD_BLOCK;
+        }
+    } while (!__atomic_compare_exchange_n(&mState, &s, s | WRITER, false,
+            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    __atomic_add_fetch(&mWriters, 1, __ATOMIC_RELAXED);
+    return NO_ERROR;
+}
+
+void RWLock::writeUnlock() {
+    if (__atomic_sub_fetch(&mWriters, 1, __ATOMIC_RELAXED) == 0) {
+        __atomic_and_fetch(&mState, ~WRITER, __ATOMIC_RELEASE);
+        futexWake(&mState, INT_MAX);
+    }
+    // else another writer is queued on mWriterLock: leave WRITER set so no
+    // reader slips in between, and let it inherit the lock.
+    mWriterLock.unlock();
+}
+
+}; // namespace ThreadManager
@@ -1,511 +1,933 @@
-/*
- * Copyright (C) ThreadManager Module Project.
- * @Author chenglan@ucweb.com 
- * @Date 2014-12-30
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include "Thread.h"
-#include "logging.h"
-#include "AndroidThreads.h"
-#include "Errors.h"
-#include "Looper.h"
-#include "sched_policy.h"
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <memory.h>
-#include <errno.h>
-#include <assert.h>
-#include <unistd.h>
-#include <jni.h>
-
-#if defined(HAVE_PTHREADS)
-# include <pthread.h>
-# include <sched.h>
-# include <sys/resource.h>
-#ifdef HAVE_ANDROID_OS
-# include "bionic_pthread.h"
-#endif
-#endif
-
-#if defined(HAVE_PRCTL)
-#include <sys/prctl.h>
-#endif
-
-
-using namespace ThreadManager;
-
-// ----------------------------------------------------------------------------
-#if defined(HAVE_PTHREADS)
-// ----------------------------------------------------------------------------
-
-/*
- * Create and run a new thread.
- *
- * We create it "detached", so it cleans up after itself.
- */
-
-typedef void* (*android_pthread_entry)(void*);
-
-static pthread_once_t gDoSchedulingGroupOnce = PTHREAD_ONCE_INIT;
-static bool gDoSchedulingGroup = true;
-
-static void checkDoSchedulingGroup(void) {
-    char buf[PROPERTY_VALUE_MAX];
-    int len = 0;//property_get("debug.sys.noschedgroups", buf, "");
-    if (len > 0) {
-        int temp;
-        if (sscanf(buf, "%d", &temp) == 1) {
-            gDoSchedulingGroup = temp == 0;
-        }
-    }
-}
-
-struct thread_data_t {
-    thread_func_t   entryFunction;
-    void*           userData;
-    int             priority;
-    char *          threadName;
-
-    // we use this trampoline when we need to set the priority with
-    // nice/setpriority, and name with prctl.
-    static int trampoline(const thread_data_t* t) {
-        thread_func_t f = t->entryFunction;
-        void* u = t->userData;
-        int prio = t->priority;
-        char * name = t->threadName;
-        delete t;
-        setpriority(PRIO_PROCESS, 0, prio);
-        pthread_once(&gDoSchedulingGroupOnce, checkDoSchedulingGroup);
-        if (gDoSchedulingGroup) {
-            if (prio >= ANDROID_PRIORITY_BACKGROUND) {
-                set_sched_policy(androidGetTid(), SP_BACKGROUND);
-            } else if (prio > ANDROID_PRIORITY_AUDIO) {
-                set_sched_policy(androidGetTid(), SP_FOREGROUND);
-            } else {
-                // defaults to that of parent, or as set by requestPriority()
-            }
-        }
-        
-        if (name) {
-#if defined(HAVE_PRCTL)
-            // Mac OS doesn't have this, and we build libutil for the host too
-            int hasAt = 0;
-            int hasDot = 0;
-            char *s = name;
-            while (*s) {
-                if (*s == '.') hasDot = 1;
-                else if (*s == '@') hasAt = 1;
-                s++;
-            }
-            int len = s - name;
-            if (len < 15 || hasAt || !hasDot) {
-                s = name;
-            } else {
-                s = name + len - 15;
-            }
-            prctl(PR_SET_NAME, (unsigned long) s, 0, 0, 0);
-#endif
-            free(name);
-        }
-        return f(u);
-    }
-};
-
-int androidCreateRawThreadEtc(android_thread_func_t entryFunction,
-                               void *userData,
-                               const char* threadName,
-                               int32_t threadPriority,
-                               size_t threadStackSize,
-                               android_thread_id_t *threadId)
-{
-    pthread_attr_t attr; 
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-
-#ifdef HAVE_ANDROID_OS  /* valgrind is rejecting RT-priority create reqs */
-    if (threadPriority != PRIORITY_DEFAULT || threadName != NULL) {
-        // Now that the pthread_t has a method to find the associated
-        // android_thread_id_t (pid) from pthread_t, it would be possible to avoid
-        // this trampoline in some cases as the parent could set the properties
-        // for the child.  However, there would be a race condition because the
-        // child becomes ready immediately, and it doesn't work for the name.
-        // prctl(PR_SET_NAME) only works for self; prctl(PR_SET_THREAD_NAME) was
-        // proposed but not yet accepted.
-        thread_data_t* t = new thread_data_t;
-        t->priority = threadPriority;
-        t->threadName = threadName ? strdup(threadName) : NULL;
-        t->entryFunction = entryFunction;
-        t->userData = userData;
-        entryFunction = (android_thread_func_t)&thread_data_t::trampoline;
-        userData = t;            
-    }
-#endif
-
-    if (threadStackSize) {
-        pthread_attr_setstacksize(&attr, threadStackSize);
-    }
-    
-    errno = 0;
-    pthread_t thread;
-    int result = pthread_create(&thread, &attr,
-                    (android_pthread_entry)entryFunction, userData);
-    pthread_attr_destroy(&attr);
-    if (result != 0) {
-        ALOGE("androidCreateRawThreadEtc failed (entry=%p, res=%d, errno=%d)\n"
-             "(android threadPriority=%d)",
-            entryFunction, result, errno, threadPriority);
-        return 0;
-    }
-
-    // Note that *threadID is directly available to the parent only, as it is
-    // assigned after the child starts.  Use memory barrier / lock if the child
-    // or other threads also need access.
-    if (threadId != NULL) {
-        *threadId = (android_thread_id_t)thread; // XXX: this is not portable
-    }
-    return 1;
-}
-
-#ifdef HAVE_ANDROID_OS
-static pthread_t android_thread_id_t_to_pthread(android_thread_id_t thread)
-{
-    return (pthread_t) thread;
-}
-#endif
-
-android_thread_id_t androidGetThreadId()
-{
-    return (android_thread_id_t)pthread_self();
-}
-
-#else
-#error "Threads not supported"
-#endif
-
-// ----------------------------------------------------------------------------
-
-int androidCreateThread(android_thread_func_t fn, void* arg)
-{
-    return createThreadEtc(fn, arg);
-}
-
-int androidCreateThreadGetID(android_thread_func_t fn, void *arg, android_thread_id_t *id)
-{
-    return createThreadEtc(fn, arg, "android:unnamed_thread",
-                           PRIORITY_DEFAULT, 0, id);
-}
-
-static android_create_thread_fn gCreateThreadFn = androidCreateRawThreadEtc;
-
-int androidCreateThreadEtc(android_thread_func_t entryFunction,
-                            void *userData,
-                            const char* threadName,
-                            int32_t threadPriority,
-                            size_t threadStackSize,
-                            android_thread_id_t *threadId)
-{
-    return gCreateThreadFn(entryFunction, userData, threadName,
-        threadPriority, threadStackSize, threadId);
-}
-
-void androidSetCreateThreadFunc(android_create_thread_fn func)
-{
-    gCreateThreadFn = func;
-}
-
-int32_t androidGetTid()
-{
-#ifdef HAVE_GETTID
-    return gettid();
-#else
-    return getpid();
-#endif
-}
-
-#ifdef HAVE_ANDROID_OS
-int androidSetThreadPriority(int32_t tid, int pri)
-{
-    int rc = 0;
-    
-#if defined(HAVE_PTHREADS)
-    int lasterr = 0;
-
-    pthread_once(&gDoSchedulingGroupOnce, checkDoSchedulingGroup);
-    if (gDoSchedulingGroup) {
-        // set_sched_policy does not support tid == 0
-        int policy_tid;
-        if (tid == 0) {
-            policy_tid = androidGetTid();
-        } else {
-            policy_tid = tid;
-        }
-        if (pri >= ANDROID_PRIORITY_BACKGROUND) {
-            rc = set_sched_policy(policy_tid, SP_BACKGROUND);
-        } else if (getpriority(PRIO_PROCESS, tid) >= ANDROID_PRIORITY_BACKGROUND) {
-            rc = set_sched_policy(policy_tid, SP_FOREGROUND);
-        }
-    }
-
-    if (rc) {
-        lasterr = errno;
-    }
-
-    if (setpriority(PRIO_PROCESS, tid, pri) < 0) {
-        rc = INVALID_OPERATION;
-    } else {
-        errno = lasterr;
-    }
-#endif
-    
-    return rc;
-}
-
-int androidGetThreadPriority(int32_t tid) {
-#if defined(HAVE_PTHREADS)
-    return getpriority(PRIO_PROCESS, tid);
-#else
-    return ANDROID_PRIORITY_NORMAL;
-#endif
-}
-
-#endif
-
-
-namespace ThreadManager{
-	
-/*
-* This is our thread object!
-*/
-	
-Thread::Thread(bool canCallJava)
-	:	mCanCallJava(canCallJava),
-		mThread(thread_id_t(-1)),
-		mHoldSelf(NULL),
-		mLock(),
-		mStatus(NO_ERROR),
-		mExitPending(false), mRunning(false)
-#ifdef HAVE_ANDROID_OS
-		, mTid(-1)
-#endif
-{
-}
-	
-Thread::~Thread()
-{
-}
-	
-status_t Thread::readyToRun()
-{
-		return NO_ERROR;
-}
-	
-status_t Thread::run(const char* name, int32_t priority, size_t stack)
-{
-	Mutex::Autolock _l(mLock);
-	
-	if (mRunning) {
-		// thread already started
-		return INVALID_OPERATION;
-	}
-	
-	// reset status and exitPending to their default value, so we can
-	// try again after an error happened (either below, or in readyToRun())
-	mStatus = NO_ERROR;
-	mExitPending = false;
-	mThread = thread_id_t(-1);
-		
-	// hold a strong reference on ourself
-	mHoldSelf = this;
-	
-	mRunning = true;
-	
-	bool res;
-	if (mCanCallJava) {
-		res = createThreadEtc(_threadLoop,
-				this, name, priority, stack, &mThread);
-	} else {
-		res = androidCreateRawThreadEtc(_threadLoop,
-				this, name, priority, stack, &mThread);
-	}
-		
-	if (res == false) {
-		mStatus = UNKNOWN_ERROR;   // something happened!
-		mRunning = false;
-		mThread = thread_id_t(-1);
-		//mHoldSelf.clear();	// "this" may have gone away after this.
-	
-		return UNKNOWN_ERROR;
-	}
-		
-	// Do not refer to mStatus here: The thread is already running (may, in fact
-	// already have exited with a valid mStatus result). The NO_ERROR indication
-	// here merely indicates successfully starting the thread and does not
-	// imply successful termination/execution.
-	return NO_ERROR;
-	
-	// Exiting scope of mLock is a memory barrier and allows new thread to run
-}
-	
-int Thread::_threadLoop(void* user)
-{
-	Thread* const self = static_cast<Thread*>(user);
-	
-#ifdef HAVE_ANDROID_OS
-	// this is very useful for debugging with gdb
-	self->mTid = gettid();
-#endif
-	do{
-		bool first = true;
-		bool result;
-		if (first) {
-			first = false;
-			self->mStatus = self->readyToRun();
-			result = (self->mStatus == NO_ERROR);
-	
-			if (result && !self->exitPending()) {
-				result = self->threadLoop();
-			}
-		} else {
-			result = self->threadLoop();
-		}
-	
-	
-		{//acquire lock
-			Mutex::Autolock _l(self->mLock);
-			if (result == false || self->mExitPending) {
-				self->mExitPending = true;
-				self->mRunning = false;
-				// clear thread ID so that requestExitAndWait() does not exit if
-				// called by a new thread using the same thread ID as this one.
-				self->mThread = thread_id_t(-1);
-				// note that interested observers blocked in requestExitAndWait are
-				// awoken by broadcast, but blocked on mLock until break exits scope
-				self->mThreadExitedCondition.broadcast();
-				break;
-			}
-		}//release lock
-	
-	}while(true);
-		
-	return 0;
-}
-	
-void Thread::requestExit()
-{
-	Mutex::Autolock _l(mLock);
-	mExitPending = true;
-}
-	
-status_t Thread::requestExitAndWait()
-{
-	Mutex::Autolock _l(mLock);
-	if (mThread == getThreadId()) {
-		ALOGW(
-			"Thread (this=%p): don't call waitForExit() from this "
-			"Thread object's thread. It's a guaranteed deadlock!",
-			this);
-	
-		return WOULD_BLOCK;
-	}
-		
-	mExitPending = true;
-	
-	while (mRunning == true) {
-		mThreadExitedCondition.wait(mLock);
-	}
-	// This next line is probably not needed any more, but is being left for
-	// historical reference. Note that each interested party will clear flag.
-	mExitPending = false;
-	
-	return mStatus;
-}
-	
-status_t Thread::join()
-{
-	Mutex::Autolock _l(mLock);
-	if (mThread == getThreadId()) {
-			ALOGW(
-			"Thread (this=%p): don't call join() from this "
-			"Thread object's thread. It's a guaranteed deadlock!",
-			this);
-	
-		return WOULD_BLOCK;
-	}
-	
-	while (mRunning == true) {
-		mThreadExitedCondition.wait(mLock);
-	}
-	
-	return mStatus;
-}
-	
-#ifdef HAVE_ANDROID_OS
-int32_t Thread::getTid() const
-{
-	// mTid is not defined until the child initializes it, and the caller may need it earlier
-	Mutex::Autolock _l(mLock);
-	int32_t tid;
-	if (mRunning) {
-		pthread_t pthread = android_thread_id_t_to_pthread(mThread);
-		tid = __pthread_gettid(pthread);
-	} else {
-		ALOGW("Thread (this=%p): getTid() is undefined before run()", this);
-		tid = -1;
-	}
-	return tid;
-}
-#endif
-	
-bool Thread::exitPending() const
-{
-	Mutex::Autolock _l(mLock);
-	return mExitPending;
-}
-
-//------------- HandleThread ------------
-HandleThread::HandleThread(LooperPolicyInterface*  policy) :
-        Thread(/*canCallJava*/ true),mLooper(NULL){
-		mPolicy = policy;
-}
-
-HandleThread::~HandleThread() {
-	delete mLooper;
-	mLooper = NULL;
-}
-
-LooperInterface* HandleThread::getLooper(){
-	Mutex::Autolock _l(lock);
-	// If the thread has been started, Please wait until the looper has been created.
-	if(NULL == mLooper){
-		mThreadCondition.wait(lock);
-	}
-	ALOGD("Thread number %ld mlooper=%p function=%s line=%d\n", pthread_self(),mLooper,__FUNCTION__,__LINE__);
-	return mLooper;
-}
-
-bool HandleThread::threadLoop() {
-	
-	ALOGD("Thread number %ld\n", pthread_self());
-	{
-		Mutex::Autolock _l(lock);
-		mLooper = new Looper(mPolicy);
-		if(mLooper != NULL){
-			mThreadCondition.broadcast();
-		}else{
-			return false;
-		}
-		ALOGD("Thread number %ld function=%s line=%d\n", pthread_self(),__FUNCTION__,__LINE__);
-	}
-    mLooper->loopOnce();
-	
-    return true;
-}//
-
-}//namespace ThreadManager
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Thread.h"
+#include "logging.h"
+#include "AndroidThreads.h"
+#include "Errors.h"
+#include "Looper.h"
+#include "sched_policy.h"
+#include "Trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <jni.h>
+
+#if defined(HAVE_PTHREADS)
+# include <pthread.h>
+# include <sched.h>
+# include <sys/resource.h>
+# include <sys/syscall.h>
+#ifdef HAVE_ANDROID_OS
+# include "bionic_pthread.h"
+#endif
+#endif
+
+#if defined(HAVE_PRCTL)
+#include <sys/prctl.h>
+#endif
+
+#ifdef HAVE_ANDROID_OS
+#include <sys/system_properties.h>
+#endif
+
+
+using namespace ThreadManager;
+
+// ----------------------------------------------------------------------------
+#if defined(HAVE_PTHREADS)
+// ----------------------------------------------------------------------------
+
+/*
+ * Create and run a new thread.
+ *
+ * We create it "detached", so it cleans up after itself.
+ */
+
+typedef void* (*android_pthread_entry)(void*);
+
+static pthread_once_t gDoSchedulingGroupOnce = PTHREAD_ONCE_INIT;
+static bool gDoSchedulingGroup = true;
+
+static void checkDoSchedulingGroup(void) {
+    char buf[PROPERTY_VALUE_MAX];
+#ifdef HAVE_ANDROID_OS
+    int len = __system_property_get("debug.sys.noschedgroups", buf);
+#else
+    int len = 0;
+#endif
+    if (len > 0) {
+        int temp;
+        if (sscanf(buf, "%d", &temp) == 1) {
+            gDoSchedulingGroup = temp == 0;
+        }
+    }
+}
+
+struct thread_data_t {
+    thread_func_t           entryFunction;
+    void*                   userData;
+    android_thread_sched_t  sched;
+    char *                  threadName;
+
+    // we use this trampoline when we need to set the priority with
+    // nice/setpriority, the scheduling class with sched_setscheduler, and
+    // name with prctl.
+    static int trampoline(const thread_data_t* t) {
+        thread_func_t f = t->entryFunction;
+        void* u = t->userData;
+        android_thread_sched_t sched = t->sched;
+        int prio = sched.nice;
+        char * name = t->threadName;
+        delete t;
+        if (sched.policy != ANDROID_SCHED_NORMAL) {
+            // falls back to sched.nice (and logs) when the kernel says no
+            androidSetThreadPriorityEtc(0, &sched);
+        } else {
+            setpriority(PRIO_PROCESS, 0, prio);
+            pthread_once(&gDoSchedulingGroupOnce, checkDoSchedulingGroup);
+            if (gDoSchedulingGroup) {
+                if (prio >= ANDROID_PRIORITY_BACKGROUND) {
+                    set_sched_policy(androidGetTid(), SP_BACKGROUND);
+                } else if (prio > ANDROID_PRIORITY_AUDIO) {
+                    set_sched_policy(androidGetTid(), SP_FOREGROUND);
+                } else {
+                    // defaults to that of parent, or as set by requestPriority()
+                }
+            }
+        }
+        
+        if (name) {
+#if defined(HAVE_PRCTL)
+            // Mac OS doesn't have this, and we build libutil for the host too
+            int hasAt = 0;
+            int hasDot = 0;
+            char *s = name;
+            while (*s) {
+                if (*s == '.') hasDot = 1;
+                else if (*s == '@') hasAt = 1;
+                s++;
+            }
+            int len = s - name;
+            if (len < 15 || hasAt || !hasDot) {
+                s = name;
+            } else {
+                s = name + len - 15;
+            }
+            prctl(PR_SET_NAME, (unsigned long) s, 0, 0, 0);
+#endif
+            free(name);
+        }
+        return f(u);
+    }
+};
+
+static thread_data_t* newThreadData(android_thread_func_t entryFunction,
+                                    void *userData,
+                                    const char* threadName,
+                                    const android_thread_sched_t* sched)
+{
+    thread_data_t* t = new thread_data_t;
+    t->sched = *sched;
+    t->threadName = threadName ? strdup(threadName) : NULL;
+    t->entryFunction = entryFunction;
+    t->userData = userData;
+    return t;
+}
+
+// ----------------------------------------------------------------------------
+// Parked-thread cache.
+//
+// When enabled with androidSetThreadCacheLimits(), a thread whose entry
+// function returns does not exit; it parks on its own condition and the next
+// androidCreateRawThreadEtc() with the same stack size hands it the new entry
+// function instead of paying for pthread_create().  Name, priority and
+// scheduling class are re-applied by the trampoline for every job, and reset
+// to the defaults before parking.  A parked thread exits after the idle
+// timeout, or straight away if the cache is already full.
+
+struct cached_thread_t {
+    cached_thread_t*    next;       // idle list link
+    pthread_t           thread;     // set by the thread itself
+    size_t              stackSize;  // as requested at creation, 0 is the default
+    thread_data_t*      job;        // next entry function to run
+    Condition           cond;       // signalled when job is set
+};
+
+static Mutex gThreadCacheLock;
+// all of the below are guarded by gThreadCacheLock
+static cached_thread_t* gIdleThreads = NULL;
+static size_t gIdleThreadCount = 0;
+static size_t gThreadCacheMaxIdle = 0; // 0 disables the cache
+static nsecs_t gThreadCacheIdleTimeout = 0;
+
+static const int MAX_RECYCLE_HOOKS = 8;
+static android_thread_recycle_fn gRecycleHooks[MAX_RECYCLE_HOOKS];
+static int gRecycleHookCount = 0;
+
+// Undo whatever the previous job left behind on this thread.
+static void recycleCachedThread()
+{
+    android_thread_sched_t normal;
+    memset(&normal, 0, sizeof(normal));
+    normal.policy = ANDROID_SCHED_NORMAL;
+    normal.nice = ANDROID_PRIORITY_DEFAULT;
+    androidSetThreadPriorityEtc(0, &normal);
+#if defined(HAVE_PRCTL)
+    prctl(PR_SET_NAME, (unsigned long) "tm:parked", 0, 0, 0);
+#endif
+
+    int count;
+    {
+        Mutex::Autolock _l(gThreadCacheLock);
+        count = gRecycleHookCount;
+    }
+    for (int i = 0; i < count; i++) {
+        gRecycleHooks[i]();
+    }
+}
+
+static int threadCacheWorker(cached_thread_t* self)
+{
+    self->thread = pthread_self();
+    for (;;) {
+        thread_data_t* job = self->job;
+        self->job = NULL;
+        thread_data_t::trampoline(job);
+
+        recycleCachedThread();
+
+        Mutex::Autolock _l(gThreadCacheLock);
+        if (gIdleThreadCount >= gThreadCacheMaxIdle) {
+            break;
+        }
+        self->next = gIdleThreads;
+        gIdleThreads = self;
+        gIdleThreadCount++;
+
+        nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + gThreadCacheIdleTimeout;
+        while (self->job == NULL && gIdleThreadCount <= gThreadCacheMaxIdle) {
+            if (self->cond.waitUntil(gThreadCacheLock, deadline) == TIMED_OUT) {
+                break;
+            }
+        }
+        if (self->job == NULL) {
+            // Timed out, or the cache shrank; nobody can hand us a job once
+            // we are off the list.
+            cached_thread_t** p = &gIdleThreads;
+            while (*p != self) {
+                p = &(*p)->next;
+            }
+            *p = self->next;
+            gIdleThreadCount--;
+            break;
+        }
+        // The creator unlinked us when it set the job.
+    }
+    delete self;
+    return 0;
+}
+
+// Hand the entry function to a parked thread.  Returns false if none fits.
+static bool threadCacheReuse(android_thread_func_t entryFunction,
+                             void *userData,
+                             const char* threadName,
+                             const android_thread_sched_t* sched,
+                             size_t threadStackSize,
+                             android_thread_id_t *threadId)
+{
+    Mutex::Autolock _l(gThreadCacheLock);
+    cached_thread_t** p = &gIdleThreads;
+    while (*p != NULL && (*p)->stackSize != threadStackSize) {
+        p = &(*p)->next;
+    }
+    cached_thread_t* worker = *p;
+    if (worker == NULL) {
+        return false;
+    }
+    *p = worker->next;
+    gIdleThreadCount--;
+    worker->job = newThreadData(entryFunction, userData, threadName, sched);
+    if (threadId != NULL) {
+        // the worker is parked, so it cannot be asking for its own id yet
+        *threadId = (android_thread_id_t)worker->thread;
+    }
+    worker->cond.signal();
+    return true;
+}
+
+int androidCreateRawThreadEtc(android_thread_func_t entryFunction,
+                               void *userData,
+                               const char* threadName,
+                               int32_t threadPriority,
+                               size_t threadStackSize,
+                               android_thread_id_t *threadId)
+{
+    android_thread_sched_t sched;
+    memset(&sched, 0, sizeof(sched));
+    sched.policy = ANDROID_SCHED_NORMAL;
+    sched.nice = threadPriority;
+    return androidCreateRawThreadSchedEtc(entryFunction, userData, threadName,
+            &sched, threadStackSize, threadId);
+}
+
+int androidCreateRawThreadSchedEtc(android_thread_func_t entryFunction,
+                                   void *userData,
+                                   const char* threadName,
+                                   const android_thread_sched_t* sched,
+                                   size_t threadStackSize,
+                                   android_thread_id_t *threadId)
+{
+    bool cacheEnabled;
+    {
+        Mutex::Autolock _l(gThreadCacheLock);
+        cacheEnabled = gThreadCacheMaxIdle > 0;
+    }
+    if (cacheEnabled && threadCacheReuse(entryFunction, userData, threadName,
+            sched, threadStackSize, threadId)) {
+        return 1;
+    }
+
+    pthread_attr_t attr; 
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    const int32_t threadPriority = sched->nice;
+    cached_thread_t* worker = NULL;
+
+    if (cacheEnabled) {
+        // Start a thread that can be parked in the cache once the entry
+        // function returns.  It always goes through the trampoline.
+        worker = new cached_thread_t;
+        worker->next = NULL;
+        worker->stackSize = threadStackSize;
+        worker->job = newThreadData(entryFunction, userData, threadName, sched);
+        entryFunction = (android_thread_func_t)&threadCacheWorker;
+        userData = worker;
+    }
+#ifdef HAVE_ANDROID_OS  /* valgrind is rejecting RT-priority create reqs */
+    else if (sched->policy != ANDROID_SCHED_NORMAL
+            || threadPriority != PRIORITY_DEFAULT || threadName != NULL) {
+        // Now that the pthread_t has a method to find the associated
+        // android_thread_id_t (pid) from pthread_t, it would be possible to avoid
+        // this trampoline in some cases as the parent could set the properties
+        // for the child.  However, there would be a race condition because the
+        // child becomes ready immediately, and it doesn't work for the name.
+        // prctl(PR_SET_NAME) only works for self; prctl(PR_SET_THREAD_NAME) was
+        // proposed but not yet accepted.
+        thread_data_t* t = newThreadData(entryFunction, userData, threadName, sched);
+        entryFunction = (android_thread_func_t)&thread_data_t::trampoline;
+        userData = t;            
+    }
+#endif
+
+    if (threadStackSize) {
+        pthread_attr_setstacksize(&attr, threadStackSize);
+    }
+    
+    errno = 0;
+    pthread_t thread;
+    int result = pthread_create(&thread, &attr,
+                    (android_pthread_entry)entryFunction, userData);
+    pthread_attr_destroy(&attr);
+    if (result != 0) {
+        ALOGE("androidCreateRawThreadEtc failed (entry=%p, res=%d, errno=%d)\n"
+             "(android threadPriority=%d, sched policy=%d)",
+            entryFunction, result, errno, threadPriority, sched->policy);
+        if (worker != NULL) {
+            free(worker->job->threadName);
+            delete worker->job;
+            delete worker;
+        }
+        return 0;
+    }
+
+    // Note that *threadID is directly available to the parent only, as it is
+    // assigned after the child starts.  Use memory barrier / lock if the child
+    // or other threads also need access.
+    if (threadId != NULL) {
+        *threadId = (android_thread_id_t)thread; // XXX: this is not portable
+    }
+    return 1;
+}
+
+void androidSetThreadCacheLimits(size_t maxIdleThreads, int64_t idleTimeoutNs)
+{
+    Mutex::Autolock _l(gThreadCacheLock);
+    gThreadCacheMaxIdle = maxIdleThreads;
+    gThreadCacheIdleTimeout = idleTimeoutNs;
+    // Let parked threads beyond the new limit exit now.
+    for (cached_thread_t* t = gIdleThreads; t != NULL; t = t->next) {
+        t->cond.signal();
+    }
+}
+
+int androidAddThreadRecycleHook(android_thread_recycle_fn hook)
+{
+    Mutex::Autolock _l(gThreadCacheLock);
+    if (gRecycleHookCount >= MAX_RECYCLE_HOOKS) {
+        return -1;
+    }
+    gRecycleHooks[gRecycleHookCount++] = hook;
+    return 0;
+}
+
+#ifdef HAVE_ANDROID_OS
+static pthread_t android_thread_id_t_to_pthread(android_thread_id_t thread)
+{
+    return (pthread_t) thread;
+}
+#endif
+
+android_thread_id_t androidGetThreadId()
+{
+    return (android_thread_id_t)pthread_self();
+}
+
+#else
+#error "Threads not supported"
+#endif
+
+// ----------------------------------------------------------------------------
+
+int androidCreateThread(android_thread_func_t fn, void* arg)
+{
+    return createThreadEtc(fn, arg);
+}
+
+int androidCreateThreadGetID(android_thread_func_t fn, void *arg, android_thread_id_t *id)
+{
+    return createThreadEtc(fn, arg, "android:unnamed_thread",
+                           PRIORITY_DEFAULT, 0, id);
+}
+
+static android_create_thread_fn gCreateThreadFn = androidCreateRawThreadEtc;
+
+int androidCreateThreadEtc(android_thread_func_t entryFunction,
+                            void *userData,
+                            const char* threadName,
+                            int32_t threadPriority,
+                            size_t threadStackSize,
+                            android_thread_id_t *threadId)
+{
+    return gCreateThreadFn(entryFunction, userData, threadName,
+        threadPriority, threadStackSize, threadId);
+}
+
+void androidSetCreateThreadFunc(android_create_thread_fn func)
+{
+    gCreateThreadFn = func;
+}
+
+int32_t androidGetTid()
+{
+#ifdef HAVE_GETTID
+    return gettid();
+#else
+    return getpid();
+#endif
+}
+
+#ifdef HAVE_ANDROID_OS
+int androidSetThreadPriority(int32_t tid, int pri)
+{
+    int rc = 0;
+    
+#if defined(HAVE_PTHREADS)
+    int lasterr = 0;
+
+    pthread_once(&gDoSchedulingGroupOnce, checkDoSchedulingGroup);
+    if (gDoSchedulingGroup) {
+        // set_sched_policy does not support tid == 0
+        int policy_tid;
+        if (tid == 0) {
+            policy_tid = androidGetTid();
+        } else {
+            policy_tid = tid;
+        }
+        if (pri >= ANDROID_PRIORITY_BACKGROUND) {
+            rc = set_sched_policy(policy_tid, SP_BACKGROUND);
+        } else if (getpriority(PRIO_PROCESS, tid) >= ANDROID_PRIORITY_BACKGROUND) {
+            rc = set_sched_policy(policy_tid, SP_FOREGROUND);
+        }
+    }
+
+    if (rc) {
+        lasterr = errno;
+    }
+
+    if (setpriority(PRIO_PROCESS, tid, pri) < 0) {
+        rc = INVALID_OPERATION;
+    } else {
+        errno = lasterr;
+    }
+#endif
+    
+    return rc;
+}
+
+int androidGetThreadPriority(int32_t tid) {
+#if defined(HAVE_PTHREADS)
+    return getpriority(PRIO_PROCESS, tid);
+#else
+    return ANDROID_PRIORITY_NORMAL;
+#endif
+}
+
+// sched_setattr()/sched_getattr() have no libc wrappers on older platforms.
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+#ifndef SCHED_RESET_ON_FORK
+#define SCHED_RESET_ON_FORK 0x40000000
+#endif
+
+#ifndef __NR_sched_setattr
+# if defined(__aarch64__)
+#  define __NR_sched_setattr 274
+#  define __NR_sched_getattr 275
+# elif defined(__arm__)
+#  define __NR_sched_setattr 380
+#  define __NR_sched_getattr 381
+# elif defined(__x86_64__)
+#  define __NR_sched_setattr 314
+#  define __NR_sched_getattr 315
+# elif defined(__i386__)
+#  define __NR_sched_setattr 351
+#  define __NR_sched_getattr 352
+# endif
+#endif
+
+struct sched_attr_t {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t  sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+
+static int setDeadlineScheduler(int32_t tid, const android_thread_sched_t* sched)
+{
+#if defined(__NR_sched_setattr)
+    struct sched_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = sched->runtimeNs;
+    attr.sched_deadline = sched->deadlineNs ? sched->deadlineNs : sched->periodNs;
+    attr.sched_period = sched->periodNs;
+    return syscall(__NR_sched_setattr, tid, &attr, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int getDeadlineScheduler(int32_t tid, android_thread_sched_t* sched)
+{
+#if defined(__NR_sched_getattr)
+    struct sched_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    if (syscall(__NR_sched_getattr, tid, &attr, sizeof(attr), 0) < 0) {
+        return -1;
+    }
+    sched->runtimeNs = attr.sched_runtime;
+    sched->deadlineNs = attr.sched_deadline;
+    sched->periodNs = attr.sched_period;
+    return 0;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int androidSetThreadPriorityEtc(int32_t tid, const android_thread_sched_t* sched)
+{
+    if (sched == NULL) {
+        errno = EINVAL;
+        return INVALID_OPERATION;
+    }
+
+    int policy = sched->policy;
+    int lasterr = 0;
+
+    if (policy == ANDROID_SCHED_DEADLINE) {
+        if (setDeadlineScheduler(tid, sched) == 0) {
+            goto RealTime;
+        }
+        lasterr = errno;
+        ALOGW("androidSetThreadPriorityEtc: SCHED_DEADLINE refused for tid %d (errno=%d)",
+                tid, lasterr);
+        policy = sched->priority > 0 ? ANDROID_SCHED_FIFO : ANDROID_SCHED_NORMAL;
+    }
+
+    if (policy == ANDROID_SCHED_FIFO || policy == ANDROID_SCHED_RR) {
+        struct sched_param param;
+        param.sched_priority = sched->priority;
+        if (sched_setscheduler(tid, policy == ANDROID_SCHED_FIFO ? SCHED_FIFO : SCHED_RR,
+                &param) == 0) {
+            goto RealTime;
+        }
+        lasterr = errno;
+        ALOGW("androidSetThreadPriorityEtc: %s refused for tid %d (errno=%d), "
+                "falling back to nice %d", policy == ANDROID_SCHED_FIFO ? "SCHED_FIFO"
+                : "SCHED_RR", tid, lasterr, sched->nice);
+        policy = ANDROID_SCHED_NORMAL;
+    }
+
+    {
+        // Time-sharing, either requested or as the fallback.  Leave any
+        // real-time class the thread may have been in before.
+        int current = sched_getscheduler(tid);
+        if (current >= 0 && (current & ~SCHED_RESET_ON_FORK) != SCHED_OTHER) {
+            struct sched_param param;
+            param.sched_priority = 0;
+            sched_setscheduler(tid, SCHED_OTHER, &param);
+        }
+        if (androidSetThreadPriority(tid, sched->nice) == INVALID_OPERATION) {
+            return INVALID_OPERATION;
+        }
+        if (lasterr) {
+            errno = lasterr;
+            return WOULD_BLOCK;
+        }
+        return NO_ERROR;
+    }
+
+RealTime:
+    // Real-time threads are never left in the background group.
+    pthread_once(&gDoSchedulingGroupOnce, checkDoSchedulingGroup);
+    if (gDoSchedulingGroup) {
+        set_sched_policy(tid == 0 ? androidGetTid() : tid, SP_FOREGROUND);
+    }
+    if (lasterr) {
+        errno = lasterr;
+        return WOULD_BLOCK;
+    }
+    return NO_ERROR;
+}
+
+int androidGetThreadPriorityEtc(int32_t tid, android_thread_sched_t* sched)
+{
+    memset(sched, 0, sizeof(*sched));
+
+    int policy = sched_getscheduler(tid);
+    if (policy < 0) {
+        return INVALID_OPERATION;
+    }
+    policy &= ~SCHED_RESET_ON_FORK;
+
+    errno = 0;
+    sched->nice = getpriority(PRIO_PROCESS, tid);
+    if (errno != 0) {
+        return INVALID_OPERATION;
+    }
+
+    switch (policy) {
+    case SCHED_FIFO:
+    case SCHED_RR: {
+        struct sched_param param;
+        if (sched_getparam(tid, &param) < 0) {
+            return INVALID_OPERATION;
+        }
+        sched->policy = policy == SCHED_FIFO ? ANDROID_SCHED_FIFO : ANDROID_SCHED_RR;
+        sched->priority = param.sched_priority;
+        break;
+    }
+    case SCHED_DEADLINE:
+        if (getDeadlineScheduler(tid, sched) < 0) {
+            return INVALID_OPERATION;
+        }
+        sched->policy = ANDROID_SCHED_DEADLINE;
+        break;
+    default:
+        // SCHED_OTHER, SCHED_BATCH and SCHED_IDLE are all nice-level classes.
+        sched->policy = ANDROID_SCHED_NORMAL;
+        break;
+    }
+    return 0;
+}
+
+#endif
+
+
+namespace ThreadManager{
+	
+/*
+* This is our thread object!
+*/
+	
+Thread::Thread(bool canCallJava)
+	:	mCanCallJava(canCallJava),
+		mThread(thread_id_t(-1)),
+		mHoldSelf(NULL),
+		mLock(),
+		mStatus(NO_ERROR),
+		mExitPending(false), mRunning(false)
+#ifdef HAVE_ANDROID_OS
+		, mTid(-1)
+#endif
+{
+}
+	
+Thread::~Thread()
+{
+}
+	
+status_t Thread::readyToRun()
+{
+		return NO_ERROR;
+}
+	
+status_t Thread::run(const char* name, int32_t priority, size_t stack)
+{
+	return run(name, schedNormal(priority), stack);
+}
+
+status_t Thread::run(const char* name, const thread_sched_t& sched, size_t stack)
+{
+	Mutex::Autolock _l(mLock);
+	
+	if (mRunning) {
+		// thread already started
+		return INVALID_OPERATION;
+	}
+	
+	// reset status and exitPending to their default value, so we can
+	// try again after an error happened (either below, or in readyToRun())
+	mStatus = NO_ERROR;
+	mExitPending = false;
+	mThread = thread_id_t(-1);
+		
+	// hold a strong reference on ourself
+	mHoldSelf = this;
+	
+	mRunning = true;
+	
+	bool res;
+	if (sched.policy != THREAD_SCHED_NORMAL) {
+		// The create-thread hook only knows about nice levels, so real-time
+		// threads always go through the raw trampoline.
+		res = androidCreateRawThreadSchedEtc(_threadLoop,
+				this, name, &sched, stack, &mThread);
+	} else if (mCanCallJava) {
+		res = createThreadEtc(_threadLoop,
+				this, name, sched.nice, stack, &mThread);
+	} else {
+		res = androidCreateRawThreadEtc(_threadLoop,
+				this, name, sched.nice, stack, &mThread);
+	}
+		
+	if (res == false) {
+		mStatus = UNKNOWN_ERROR;   // something happened!
+		mRunning = false;
+		mThread = thread_id_t(-1);
+		//mHoldSelf.clear();	// "this" may have gone away after this.
+	
+		return UNKNOWN_ERROR;
+	}
+		
+	// Do not refer to mStatus here: The thread is already running (may, in fact
+	// already have exited with a valid mStatus result). The NO_ERROR indication
+	// here merely indicates successfully starting the thread and does not
+	// imply successful termination/execution.
+	return NO_ERROR;
+	
+	// Exiting scope of mLock is a memory barrier and allows new thread to run
+}
+	
+int Thread::_threadLoop(void* user)
+{
+	Thread* const self = static_cast<Thread*>(user);
+	
+#ifdef HAVE_ANDROID_OS
+	// this is very useful for debugging with gdb
+	self->mTid = gettid();
+#endif
+	bool first = true;
+	do{
+		bool result;
+		if (first) {
+			first = false;
+			self->mStatus = self->readyToRun();
+			result = (self->mStatus == NO_ERROR);
+	
+			if (result && !self->exitPending()) {
+				ATRACE_NAME("Thread::threadLoop");
+				result = self->threadLoop();
+			}
+		} else {
+			ATRACE_NAME("Thread::threadLoop");
+			result = self->threadLoop();
+		}
+	
+	
+		{//acquire lock
+			Mutex::Autolock _l(self->mLock);
+			if (result == false || self->mExitPending) {
+				self->mExitPending = true;
+				self->mRunning = false;
+				// clear thread ID so that requestExitAndWait() does not exit if
+				// called by a new thread using the same thread ID as this one.
+				self->mThread = thread_id_t(-1);
+				// note that interested observers blocked in requestExitAndWait are
+				// awoken by broadcast, but blocked on mLock until break exits scope
+				self->mThreadExitedCondition.broadcast();
+				break;
+			}
+		}//release lock
+	
+	}while(true);
+		
+	return 0;
+}
+	
+void Thread::requestExit()
+{
+	Mutex::Autolock _l(mLock);
+	mExitPending = true;
+}
+	
+status_t Thread::requestExitAndWait()
+{
+	Mutex::Autolock _l(mLock);
+	if (mThread == getThreadId()) {
+		ALOGW(
+			"Thread (this=%p): don't call waitForExit() from this "
+			"Thread object's thread. It's a guaranteed deadlock!",
+			this);
+	
+		return WOULD_BLOCK;
+	}
+		
+	mExitPending = true;
+	
+	while (mRunning == true) {
+		mThreadExitedCondition.wait(mLock);
+	}
+	// This next line is probably not needed any more, but is being left for
+	// historical reference. Note that each interested party will clear flag.
+	mExitPending = false;
+	
+	return mStatus;
+}
+	
+status_t Thread::join()
+{
+	Mutex::Autolock _l(mLock);
+	if (mThread == getThreadId()) {
+			ALOGW(
+			"Thread (this=%p): don't call join() from this "
+			"Thread object's thread. It's a guaranteed deadlock!",
+			this);
+	
+		return WOULD_BLOCK;
+	}
+	
+	while (mRunning == true) {
+		mThreadExitedCondition.wait(mLock);
+	}
+	
+	return mStatus;
+}
+	
+#ifdef HAVE_ANDROID_OS
+int32_t Thread::getTid() const
+{
+	// mTid is not defined until the child initializes it, and the caller may need it earlier
+	Mutex::Autolock _l(mLock);
+	int32_t tid;
+	if (mRunning) {
+		pthread_t pthread = android_thread_id_t_to_pthread(mThread);
+		tid = __pthread_gettid(pthread);
+	} else {
+		ALOGW("Thread (this=%p): getTid() is undefined before run()", this);
+		tid = -1;
+	}
+	return tid;
+}
+
+status_t Thread::getSchedPolicy(thread_sched_t* sched) const
+{
+	int32_t tid = getTid();
+	if (tid < 0) {
+		return INVALID_OPERATION;
+	}
+	return androidGetThreadPriorityEtc(tid, sched);
+}
+#endif
+	
+bool Thread::exitPending() const
+{
+	Mutex::Autolock _l(mLock);
+	return mExitPending;
+}
+
+//------------- HandleThread ------------
+HandleThread::HandleThread(LooperPolicyInterface*  policy) :
+        Thread(/*canCallJava*/ true),mLooper(NULL){
+		mPolicy = policy;
+}
+
+HandleThread::~HandleThread() {
+	delete mLooper;
+	mLooper = NULL;
+}
+
+LooperInterface* HandleThread::getLooper(){
+	Mutex::Autolock _l(lock);
+	// If the thread has been started, Please wait until the looper has been created.
+	while(NULL == mLooper){
+		mThreadCondition.wait(lock);
+	}
+	ALOGD("Thread number %ld mlooper=%p function=%s line=%d\n", pthread_self(),mLooper,__FUNCTION__,__LINE__);
+	return mLooper;
+}
+
+LooperInterface* HandleThread::getLooper(nsecs_t timeout){
+	Mutex::Autolock _l(lock);
+	const nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + timeout;
+	while(NULL == mLooper){
+		if(mThreadCondition.waitUntil(lock, deadline) == TIMED_OUT){
+			break;
+		}
+	}
+	return mLooper;
+}
+
+bool HandleThread::threadLoop() {
+	
+	ALOGD("Thread number %ld\n", pthread_self());
+	{
+		Mutex::Autolock _l(lock);
+		mLooper = new Looper(mPolicy);
+		if(mLooper != NULL){
+			mThreadCondition.broadcast();
+		}else{
+			return false;
+		}
+		ALOGD("Thread number %ld function=%s line=%d\n", pthread_self(),__FUNCTION__,__LINE__);
+	}
+    mLooper->loopOnce();
+	
+    return true;
+}//
+
+}//namespace ThreadManager
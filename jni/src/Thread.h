@@ -55,6 +55,12 @@ public:
     virtual status_t    run(    const char* name = 0,
                                 int32_t priority = PRIORITY_DEFAULT,
                                 size_t stack = 0);
+
+    // Same, but start the thread in the scheduling class described by sched
+    // (see schedNormal(), schedRealtime() and schedDeadline() in ThreadDefs.h).
+    virtual status_t    run(    const char* name,
+                                const thread_sched_t& sched,
+                                size_t stack = 0);
     
     // Ask this object's thread to exit. This function is asynchronous, when the
     // function returns the thread might still be running. Of course, this
@@ -78,6 +84,11 @@ public:
     // Return the thread's kernel ID, same as the thread itself calling gettid() or
     // androidGetTid(), or -1 if the thread is not running.
             int32_t     getTid() const;
+
+    // Return the scheduling class the thread actually runs in, which may be a
+    // fallback of the one requested in run().  INVALID_OPERATION if the
+    // thread is not running.
+            status_t    getSchedPolicy(thread_sched_t* sched) const;
 #endif
 
 protected:
@@ -125,6 +136,9 @@ public:
 	HandleThread(LooperPolicyInterface*  policy);
 	virtual ~HandleThread();
 	virtual LooperInterface* getLooper();
+	// Same, but give up after timeout; returns NULL if the looper is not
+	// ready by then (e.g. the thread was never started).
+	LooperInterface* getLooper(nsecs_t timeout);
 	
 private:
 	virtual bool  			threadLoop();
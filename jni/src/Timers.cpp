@@ -23,8 +23,107 @@
 #include <sys/time.h>
 #include <time.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
 
+#if defined(HAVE_POSIX_CLOCKS)
+
+#if defined(__aarch64__) || defined(__x86_64__)
+#define HAVE_CYCLE_COUNTER 1
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+#endif
+
+static inline nsecs_t clockTime(clockid_t id)
+{
+    struct timespec t;
+    t.tv_sec = t.tv_nsec = 0;
+    clock_gettime(id, &t);
+    return nsecs_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+#if defined(HAVE_CYCLE_COUNTER)
+// How long to calibrate the TSC against CLOCK_MONOTONIC; cntvct_el0 has its
+// frequency in cntfrq_el0 and needs no calibration.
+static const nsecs_t TSC_CALIBRATION_NS = 5000000LL;
+
+// SYSTEM_TIME_FAST = nsBase + ((counter - counterBase) * mult) >> 32
+static struct {
+    uint64_t counterBase;
+    nsecs_t  nsBase;
+    uint64_t mult;
+    bool     usable;
+} gFastClock;
+static pthread_once_t gFastClockOnce = PTHREAD_ONCE_INIT;
+
+static inline uint64_t readCycleCounter()
+{
+#if defined(__aarch64__)
+    uint64_t v;
+    __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r"(v) :: "memory");
+    return v;
+#else
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return (uint64_t(hi) << 32) | lo;
+#endif
+}
+
+static void calibrateFastClock()
+{
+#if defined(__aarch64__)
+    uint64_t freq;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(freq));
+    if (freq == 0) {
+        ALOGW("cntfrq_el0 is not set, SYSTEM_TIME_FAST falls back to CLOCK_MONOTONIC");
+        return;
+    }
+    gFastClock.mult = uint64_t((unsigned __int128)(1000000000ULL) << 32) / freq;
+    gFastClock.nsBase = clockTime(CLOCK_MONOTONIC);
+    gFastClock.counterBase = readCycleCounter();
+#else
+    // Only an invariant TSC ticks at a constant rate across P-states and
+    // deep C-states.
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8))) {
+        ALOGW("no invariant TSC, SYSTEM_TIME_FAST falls back to CLOCK_MONOTONIC");
+        return;
+    }
+    nsecs_t t0 = clockTime(CLOCK_MONOTONIC);
+    uint64_t c0 = readCycleCounter();
+    nsecs_t t1;
+    uint64_t c1;
+    do {
+        t1 = clockTime(CLOCK_MONOTONIC);
+        c1 = readCycleCounter();
+    } while (t1 - t0 < TSC_CALIBRATION_NS);
+    gFastClock.mult = uint64_t(((unsigned __int128)(t1 - t0) << 32) / (c1 - c0));
+    gFastClock.nsBase = t1;
+    gFastClock.counterBase = c1;
+#endif
+    gFastClock.usable = true;
+}
+
+static nsecs_t fastSystemTime()
+{
+    pthread_once(&gFastClockOnce, calibrateFastClock);
+    if (!gFastClock.usable) {
+        return clockTime(CLOCK_MONOTONIC);
+    }
+    int64_t delta = int64_t(readCycleCounter() - gFastClock.counterBase);
+    if (delta < 0) {
+        // read on a core whose counter lags the calibrating one
+        delta = 0;
+    }
+    return gFastClock.nsBase
+            + nsecs_t(((unsigned __int128)delta * gFastClock.mult) >> 32);
+}
+#endif // HAVE_CYCLE_COUNTER
+
+#endif // HAVE_POSIX_CLOCKS
+
 nsecs_t systemTime(int clock)
 {
 #if defined(HAVE_POSIX_CLOCKS)
@@ -33,12 +132,16 @@ nsecs_t systemTime(int clock)
             CLOCK_MONOTONIC,
             CLOCK_PROCESS_CPUTIME_ID,
             CLOCK_THREAD_CPUTIME_ID,
-            CLOCK_BOOTTIME
+            CLOCK_BOOTTIME,
+            CLOCK_MONOTONIC_COARSE,
+            CLOCK_MONOTONIC
     };
-    struct timespec t;
-    t.tv_sec = t.tv_nsec = 0;
-    clock_gettime(clocks[clock], &t);
-    return nsecs_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+#if defined(HAVE_CYCLE_COUNTER)
+    if (clock == SYSTEM_TIME_FAST) {
+        return fastSystemTime();
+    }
+#endif
+    return clockTime(clocks[clock]);
 #else
     // we don't support the clocks here.
     struct timeval t;
@@ -64,6 +167,19 @@ int toMillisecondTimeoutDelay(nsecs_t referenceTime, nsecs_t timeoutTime)
     return timeoutDelayMillis;
 }
 
+void ThreadManager::formatDuration(char* buf, size_t size, nsecs_t ns)
+{
+    if (ns < 1000LL) {
+        snprintf(buf, size, "%" PRId64 "ns", ns);
+    } else if (ns < 1000000LL) {
+        snprintf(buf, size, "%.1fus", ns / 1e3);
+    } else if (ns < 1000000000LL) {
+        snprintf(buf, size, "%.2fms", ns / 1e6);
+    } else {
+        snprintf(buf, size, "%.3fs", ns / 1e9);
+    }
+}
+
 
 /*
  * ===========================================================================
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Trace.h"
+#include "logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+int32_t gTraceMarkerEnabled = 0;
+
+// Longer section names are truncated.
+#define TRACE_MESSAGE_MAX 1024
+
+static const char* const kTraceMarkerPaths[] = {
+    "/sys/kernel/tracing/trace_marker",
+    "/sys/kernel/debug/tracing/trace_marker",
+};
+
+static pthread_mutex_t gTraceMarkerLock = PTHREAD_MUTEX_INITIALIZER;
+// Written once, under the lock, before tracing is first enabled.
+static int gTraceMarkerFd = -1;
+static int gTracePid = 0;
+static char gTraceEnd[32];
+static int gTraceEndLength = 0;
+
+int androidSetTraceMarker(int enable)
+{
+    int result = 0;
+    pthread_mutex_lock(&gTraceMarkerLock);
+    if (enable && gTraceMarkerFd < 0) {
+        int fd = -1;
+        for (size_t i = 0; i < sizeof(kTraceMarkerPaths) / sizeof(kTraceMarkerPaths[0]); i++) {
+            fd = open(kTraceMarkerPaths[i], O_WRONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                break;
+            }
+            result = -errno;
+        }
+        if (fd < 0) {
+            ALOGW("Could not open trace_marker: %s", strerror(-result));
+        } else {
+            result = 0;
+            gTracePid = getpid();
+            gTraceEndLength = snprintf(gTraceEnd, sizeof(gTraceEnd), "E|%d", gTracePid);
+            gTraceMarkerFd = fd;
+        }
+    }
+    if (gTraceMarkerFd >= 0) {
+        __atomic_store_n(&gTraceMarkerEnabled, enable ? 1 : 0, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&gTraceMarkerLock);
+    return result;
+}
+
+void androidTraceBegin(const char* name)
+{
+    char buf[TRACE_MESSAGE_MAX];
+    int len = snprintf(buf, sizeof(buf), "B|%d|%s", gTracePid, name);
+    if (len >= (int) sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+    write(gTraceMarkerFd, buf, len);
+}
+
+void androidTraceEnd(void)
+{
+    write(gTraceMarkerFd, gTraceEnd, gTraceEndLength);
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) ThreadManager Module Project.
+ * @Author chenglan@ucweb.com 
+ * @Date 2014-12-30
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef _LIBS_TYPEDHANDLER_H
+#define _LIBS_TYPEDHANDLER_H
+
+#include "logging.h"
+#include "Messagehandler.h"
+#include "Message.h"
+
+namespace ThreadManager{
+
+/*
+ * A handler whose messages are known at compile time.
+ *
+ * Each type in Msgs is a tag naming one message kind:
+ *
+ *     struct Resize { enum { what = 3 }; };
+ *
+ * and Derived has a handle(Resize, const Message&) for each of them.  The
+ * whats index a table of direct calls built at compile time, so the looper
+ * reaches handle() through one virtual call (dispatchMessage()) instead of
+ * dispatchMessage() -> consumeMessage() -> handleMessage() -> policy.
+ * Other whats go to Derived::handleUnknown(), which logs by default.
+ *
+ * Keep the whats small: the table has an entry for every value up to the
+ * biggest.
+ */
+template <typename Derived, typename... Msgs>
+class TypedHandler : public MessageHandler {
+public:
+	TypedHandler(LooperInterface* looper, MessageHandler::Callback* queue)
+			: MessageHandler(looper, queue, NULL){}
+
+	virtual bool dispatchMessage(Message* mMessage) final {
+		dispatch(*mMessage);
+		return OK;
+	}
+
+	virtual bool handleMessage(const Message* const mMessage) const {
+		// Handlers keep state; this is only const for the interface.
+		const_cast<TypedHandler*>(this)->dispatch(*mMessage);
+		return OK;
+	}
+
+	/**
+     * Obtain a message for Msg and send it now.
+     */
+	template <typename Msg>
+	bool send(int32_t arg1 = 0, int32_t arg2 = 0){
+		static_assert(indexOf<Msg>() >= 0, "Msg is not handled here");
+		Message* msg = obtainMessage(Msg::what, arg1, arg2);
+		if (NULL == msg) {
+			return false;
+		}
+		if (!sendMessage(*msg, systemTime(SYSTEM_TIME_MONOTONIC))) {
+			msg->recycle();
+			return false;
+		}
+		return true;
+	}
+
+	//Called for whats with no handle(); override in Derived.
+	void handleUnknown(const Message& msg){
+		ALOGW("TypedHandler %p: no handler for what=%d", this, msg.getWhat());
+	}
+
+private:
+	typedef void (*Entry)(Derived& self, const Message& msg);
+
+	static constexpr int32_t maxWhat(){
+		int32_t max = -1;
+		((max = Msgs::what > max ? (int32_t) Msgs::what : max), ...);
+		return max;
+	}
+
+	static constexpr bool whatsValid(){
+		const int32_t whats[] = { (int32_t) Msgs::what... };
+		for (size_t i = 0; i < sizeof...(Msgs); i++) {
+			if (whats[i] < 0) {
+				return false;
+			}
+			for (size_t j = 0; j < i; j++) {
+				if (whats[i] == whats[j]) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	template <typename Msg>
+	static constexpr int indexOf(){
+		const bool same[] = { std::is_same<Msg, Msgs>::value... };
+		for (size_t i = 0; i < sizeof...(Msgs); i++) {
+			if (same[i]) {
+				return (int) i;
+			}
+		}
+		return -1;
+	}
+
+	static_assert(sizeof...(Msgs) > 0, "TypedHandler needs message types");
+	static_assert(whatsValid(), "whats must be distinct and not negative");
+
+	enum {
+		TABLE_SIZE = maxWhat() + 1
+	};
+
+	struct Table {
+		Entry entries[TABLE_SIZE];
+	};
+
+	template <typename Msg>
+	static void invoke(Derived& self, const Message& msg){
+		self.handle(Msg(), msg);
+	}
+
+	static void unknown(Derived& self, const Message& msg){
+		self.handleUnknown(msg);
+	}
+
+	static constexpr Table makeTable(){
+		Table table = {};
+		for (int32_t i = 0; i < TABLE_SIZE; i++) {
+			table.entries[i] = &unknown;
+		}
+		((table.entries[Msgs::what] = &invoke<Msgs>), ...);
+		return table;
+	}
+
+	static constexpr Table sTable = makeTable();
+
+	inline void dispatch(const Message& msg){
+		uint32_t what = (uint32_t) msg.getWhat();
+		Derived& self = static_cast<Derived&>(*this);
+		if (what < (uint32_t) TABLE_SIZE) {
+			sTable.entries[what](self, msg);
+		} else {
+			self.handleUnknown(msg);
+		}
+	}
+};
+
+}//namespace ThreadManager
+
+#endif //_LIBS_TYPEDHANDLER_H
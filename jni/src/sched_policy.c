@@ -50,39 +50,92 @@ static pthread_once_t the_once = PTHREAD_ONCE_INIT;
 
 static int __sys_supports_schedgroups = -1;
 
-// File descriptors open to /dev/cpuctl/../tasks, setup by initialize, or -1 on error.
-static int bg_cgroup_fd = -1;
-static int fg_cgroup_fd = -1;
+/* The hierarchies a thread is moved in.  Only cgroup v1 is supported:
+ * Android mounts the cpu and cpuset controllers there, and has no fixed
+ * per-policy layout under the v2 tree. */
+enum {
+    CG_CPU = 0,     // cgroup v1 cpu controller, /dev/cpuctl
+    CG_CPUSET,      // cgroup v1 cpuset controller, /dev/cpuset
+    CG_CNT
+};
+
+/* The groups a thread can be moved to. */
+enum {
+    CG_GROUP_BG = 0,
+    CG_GROUP_FG,
 #if CAN_SET_SP_SYSTEM
-static int system_cgroup_fd = -1;
+    CG_GROUP_SYSTEM,
 #endif
+    CG_GROUP_CNT
+};
+
+typedef struct {
+    int controller;
+    int group;
+    const char* path;   // the file a tid is written to
+} cgroup_path_t;
+
+/* Candidate files, in order of preference; the first one that can be opened
+ * for a (controller, group) pair wins.  The older Android layout keeps apps
+ * in /dev/cpuctl/apps, the newer one keeps them in the root group. */
+static const cgroup_path_t cgroup_paths[] = {
+    { CG_CPU,     CG_GROUP_FG, "/dev/cpuctl/apps/tasks" },
+    { CG_CPU,     CG_GROUP_BG, "/dev/cpuctl/apps/bg_non_interactive/tasks" },
+    { CG_CPU,     CG_GROUP_FG, "/dev/cpuctl/tasks" },
+    { CG_CPU,     CG_GROUP_BG, "/dev/cpuctl/bg_non_interactive/tasks" },
+#if CAN_SET_SP_SYSTEM
+    { CG_CPU,     CG_GROUP_SYSTEM, "/dev/cpuctl/tasks" },
+#endif
+    { CG_CPUSET,  CG_GROUP_FG, "/dev/cpuset/foreground/tasks" },
+    { CG_CPUSET,  CG_GROUP_BG, "/dev/cpuset/background/tasks" },
+#if CAN_SET_SP_SYSTEM
+    { CG_CPUSET,  CG_GROUP_SYSTEM, "/dev/cpuset/tasks" },
+#endif
+};
 
-/* Add tid to the scheduling group defined by the policy */
-static int add_tid_to_cgroup(int tid, SchedPolicy policy)
-{
-    int fd;
+// File descriptors open to the files above, setup by initialize, or -1 on error.
+static int cgroup_fds[CG_CNT][CG_GROUP_CNT];
+
+// Held shared while writing to cgroup_fds, exclusive to close one, so no
+// thread writes to a number that was closed and reused meanwhile.
+static pthread_rwlock_t cgroup_fds_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// Non-zero if the foreground group of the cpu controller is its root group.
+static int fg_cgroup_is_root = 0;
 
+static int policy_to_group(SchedPolicy policy)
+{
     switch (policy) {
     case SP_BACKGROUND:
-        fd = bg_cgroup_fd;
-        break;
+        return CG_GROUP_BG;
     case SP_FOREGROUND:
     case SP_AUDIO_APP:
     case SP_AUDIO_SYS:
-        fd = fg_cgroup_fd;
-        break;
+        return CG_GROUP_FG;
 #if CAN_SET_SP_SYSTEM
     case SP_SYSTEM:
-        fd = system_cgroup_fd;
-        break;
+        return CG_GROUP_SYSTEM;
 #endif
     default:
-        fd = -1;
-        break;
+        return -1;
     }
+}
 
-    if (fd < 0) {
+/* Add tid to the scheduling group defined by the policy, in every hierarchy
+ * that has one.  Succeeds if at least one hierarchy accepted the tid. */
+static int add_tid_to_cgroup(int tid, SchedPolicy policy)
+{
+    int group = policy_to_group(policy);
+    int written = 0;
+    int attempted = 0;
+    int lasterr = 0;
+    int revoked[CG_CNT];
+    int revokedCount = 0;
+    int c;
+
+    if (group < 0) {
         ALOGE("add_tid_to_cgroup failed; policy=%d\n", policy);
+        errno = EINVAL;
         return -1;
     }
 
@@ -96,57 +149,140 @@ static int add_tid_to_cgroup(int tid, SchedPolicy policy)
         tid = tid / 10;
     }
 
-    if (write(fd, ptr, end - ptr) < 0) {
-        /*
-         * If the thread is in the process of exiting,
-         * don't flag an error
-         */
-        if (errno == ESRCH)
-                return 0;
-        ALOGW("add_tid_to_cgroup failed to write '%s' (%s); policy=%d\n",
-              ptr, strerror(errno), policy);
-        return -1;
+    pthread_rwlock_rdlock(&cgroup_fds_lock);
+    for (c = 0; c < CG_CNT; c++) {
+        int fd = __atomic_load_n(&cgroup_fds[c][group], __ATOMIC_RELAXED);
+        if (fd < 0) {
+            continue;
+        }
+        attempted = 1;
+        if (write(fd, ptr, end - ptr) < 0) {
+            // Logging may clobber errno; keep the write's.
+            lasterr = errno;
+            /*
+             * If the thread is in the process of exiting,
+             * don't flag an error
+             */
+            if (lasterr == ESRCH) {
+                written = 1;
+                break;
+            }
+            ALOGW("add_tid_to_cgroup failed to write '%s' (%s); policy=%d\n",
+                  ptr, strerror(lasterr), policy);
+            if (lasterr == EACCES || lasterr == EPERM) {
+                // We are not going to be allowed next time either.  Other
+                // threads may fail on the same fd; only the one that clears
+                // the slot closes it.
+                if (__atomic_compare_exchange_n(&cgroup_fds[c][group], &fd, -1,
+                        0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    revoked[revokedCount++] = fd;
+                }
+            }
+            continue;
+        }
+        written = 1;
+    }
+    pthread_rwlock_unlock(&cgroup_fds_lock);
+
+    if (revokedCount > 0) {
+        pthread_rwlock_wrlock(&cgroup_fds_lock);
+        while (revokedCount > 0) {
+            close(revoked[--revokedCount]);
+        }
+        pthread_rwlock_unlock(&cgroup_fds_lock);
     }
 
+    if (!attempted) {
+        ALOGE("add_tid_to_cgroup failed; policy=%d\n", policy);
+        errno = ENOENT;
+        return -1;
+    }
+    if (!written) {
+        errno = lasterr;
+        return -1;
+    }
     return 0;
 }
 
 static void __initialize(void) {
-    char* filename;
-    if (!access("/dev/cpuctl/tasks", F_OK)) {
-        __sys_supports_schedgroups = 1;
+    size_t i;
+    int c, g;
 
-#if CAN_SET_SP_SYSTEM
-        filename = "/dev/cpuctl/tasks";
-        system_cgroup_fd = open(filename, O_WRONLY | O_CLOEXEC);
-        if (system_cgroup_fd < 0) {
-            ALOGV("open of %s failed: %s\n", filename, strerror(errno));
+    for (c = 0; c < CG_CNT; c++) {
+        for (g = 0; g < CG_GROUP_CNT; g++) {
+            cgroup_fds[c][g] = -1;
         }
-#endif
+    }
 
-        filename = "/dev/cpuctl/apps/tasks";
-        fg_cgroup_fd = open(filename, O_WRONLY | O_CLOEXEC);
-        if (fg_cgroup_fd < 0) {
-            ALOGE("open of %s failed: %s\n", filename, strerror(errno));
+    __sys_supports_schedgroups = 0;
+    for (i = 0; i < sizeof(cgroup_paths) / sizeof(cgroup_paths[0]); i++) {
+        const cgroup_path_t* p = &cgroup_paths[i];
+        if (cgroup_fds[p->controller][p->group] >= 0) {
+            continue;
         }
-
-        filename = "/dev/cpuctl/apps/bg_non_interactive/tasks";
-        bg_cgroup_fd = open(filename, O_WRONLY | O_CLOEXEC);
-        if (bg_cgroup_fd < 0) {
-            ALOGE("open of %s failed: %s\n", filename, strerror(errno));
+        int fd = open(p->path, O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno != ENOENT) {
+                ALOGV("open of %s failed: %s\n", p->path, strerror(errno));
+            }
+            continue;
         }
+        cgroup_fds[p->controller][p->group] = fd;
+        __sys_supports_schedgroups = 1;
+        if (p->controller == CG_CPU && p->group == CG_GROUP_FG
+                && !strcmp(p->path, "/dev/cpuctl/tasks")) {
+            fg_cgroup_is_root = 1;
+        }
+    }
+
+    if (!__sys_supports_schedgroups) {
+        ALOGV("No writable cgroups; using SCHED_BATCH for background threads\n");
+    }
+}
+
+/* Map the group part of a /proc/<tid>/cgroup line to a policy. */
+static int group_to_policy(const char* grp, SchedPolicy* policy)
+{
+    const char* leaf = strrchr(grp, '/');
+    leaf = leaf ? leaf + 1 : grp;
+
+    if (grp[0] == '\0') {
+        *policy = fg_cgroup_is_root ? SP_FOREGROUND : SP_SYSTEM;
+    } else if (!strcmp(leaf, "bg_non_interactive") || !strcmp(leaf, "background")
+            || !strcmp(leaf, "system-background")) {
+        *policy = SP_BACKGROUND;
+    } else if (!strcmp(leaf, "apps") || !strcmp(leaf, "foreground")
+            || !strcmp(leaf, "top-app")) {
+        *policy = SP_FOREGROUND;
     } else {
-        __sys_supports_schedgroups = 0;
+        return -1;
     }
+    return 0;
+}
+
+/* Return non-zero if the comma separated controller list contains name. */
+static int has_controller(const char* list, const char* name)
+{
+    size_t len = strlen(name);
+    while (list && *list) {
+        if (!strncmp(list, name, len) && (list[len] == ',' || list[len] == '\0')) {
+            return 1;
+        }
+        list = strchr(list, ',');
+        if (list) list++;
+    }
+    return 0;
 }
 
 /*
  * Try to get the scheduler group.
  *
  * The data from /proc/<pid>/cgroup looks (something) like:
+ *  4:cpuset:/foreground
  *  2:cpu:/bg_non_interactive
  *  1:cpuacct:/
  *
+ * The cpu controller is preferred, then cpuset.
  * We return the part after the "/", which will be an empty string for
  * the default cgroup.  If the string is longer than "bufLen", the string
  * will be truncated.
@@ -157,6 +293,7 @@ static int getSchedulerGroup(int tid, char* buf, size_t bufLen)
     char pathBuf[32];
     char lineBuf[256];
     FILE *fp;
+    int best = CG_CNT;
 
     snprintf(pathBuf, sizeof(pathBuf), "/proc/%d/cgroup", tid);
     if (!(fp = fopen(pathBuf, "r"))) {
@@ -168,6 +305,7 @@ static int getSchedulerGroup(int tid, char* buf, size_t bufLen)
         char *subsys;
         char *grp;
         size_t len;
+        int rank;
 
         /* Junk the first field */
         if (!strsep(&next, ":")) {
@@ -178,30 +316,41 @@ static int getSchedulerGroup(int tid, char* buf, size_t bufLen)
             goto out_bad_data;
         }
 
-        if (strcmp(subsys, "cpu")) {
+        if (has_controller(subsys, "cpu")) {
+            rank = CG_CPU;
+        } else if (has_controller(subsys, "cpuset")) {
+            rank = CG_CPUSET;
+        } else {
             /* Not the subsys we're looking for */
             continue;
         }
+        if (rank >= best) {
+            continue;
+        }
 
         if (!(grp = strsep(&next, ":"))) {
             goto out_bad_data;
         }
         grp++; /* Drop the leading '/' */
         len = strlen(grp);
-        grp[len-1] = '\0'; /* Drop the trailing '\n' */
+        if (len > 0 && grp[len-1] == '\n') {
+            grp[--len] = '\0'; /* Drop the trailing '\n' */
+        }
 
         if (bufLen <= len) {
             len = bufLen - 1;
         }
         strncpy(buf, grp, len);
         buf[len] = '\0';
-        fclose(fp);
-        return 0;
+        best = rank;
     }
 
-    ALOGE("Failed to find cpu subsys");
     fclose(fp);
-    return -1;
+    if (best == CG_CNT) {
+        ALOGE("Failed to find cpu subsys");
+        return -1;
+    }
+    return 0;
  out_bad_data:
     ALOGE("Bad cgroup data {%s}", lineBuf);
     fclose(fp);
@@ -222,16 +371,10 @@ int get_sched_policy(int tid, SchedPolicy *policy)
     pthread_once(&the_once, __initialize);
 
     if (__sys_supports_schedgroups) {
-        char grpBuf[32];
+        char grpBuf[64];
         if (getSchedulerGroup(tid, grpBuf, sizeof(grpBuf)) < 0)
             return -1;
-        if (grpBuf[0] == '\0') {
-            *policy = SP_SYSTEM;
-        } else if (!strcmp(grpBuf, "apps/bg_non_interactive")) {
-            *policy = SP_BACKGROUND;
-        } else if (!strcmp(grpBuf, "apps")) {
-            *policy = SP_FOREGROUND;
-        } else {
+        if (group_to_policy(grpBuf, policy) < 0) {
             errno = ERANGE;
             return -1;
         }
@@ -308,13 +451,18 @@ int set_sched_policy(int tid, SchedPolicy policy)
                 return -errno;
         }
     } else {
-        struct sched_param param;
-
-        param.sched_priority = 0;
-        sched_setscheduler(tid,
-                           (policy == SP_BACKGROUND) ?
-                            SCHED_BATCH : SCHED_NORMAL,
-                           &param);
+        // No cgroups mounted (or none we may write): approximate with
+        // SCHED_BATCH, but never knock a thread out of a real-time class.
+        int current = sched_getscheduler(tid);
+        if (current == SCHED_NORMAL || current == SCHED_BATCH) {
+            struct sched_param param;
+
+            param.sched_priority = 0;
+            sched_setscheduler(tid,
+                               (policy == SP_BACKGROUND) ?
+                                SCHED_BATCH : SCHED_NORMAL,
+                               &param);
+        }
     }
 
     return 0;